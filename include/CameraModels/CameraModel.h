@@ -0,0 +1,171 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAMERAMODELS_CAMERAMODEL_H
+#define CAMERAMODELS_CAMERAMODEL_H
+
+#include <cmath>
+
+#include "GeometricCamera.h"
+
+namespace ORB_SLAM3 {
+
+    // Inline projection kernels of each camera model over its parameter vector. Batch loops and hot
+    // callers dispatch once on GeometricCamera::GetType() and then call the kernels directly.
+    template<unsigned int Type> struct CameraModel;
+
+    // Parameters: [fx, fy, cx, cy]
+    template<> struct CameraModel<GeometricCamera::CAM_PINHOLE> {
+        template<typename T>
+        static inline void project(const float* k, const T x, const T y, const T z, T &u, T &v) {
+            u = k[0] * x / z + k[2];
+            v = k[1] * y / z + k[3];
+        }
+
+        // Ray (x,y,1) of the pixel (u,v)
+        static inline void unproject(const float* k, const float precision, const float u, const float v, float &x, float &y) {
+            x = (u - k[2]) / k[0];
+            y = (v - k[3]) / k[1];
+        }
+
+        template<typename T>
+        static inline void projectJac(const float* k, const T x, const T y, const T z, Eigen::Matrix<T,2,3> &Jac) {
+            Jac(0, 0) = k[0] / z;
+            Jac(0, 1) = 0.f;
+            Jac(0, 2) = -k[0] * x / (z * z);
+            Jac(1, 0) = 0.f;
+            Jac(1, 1) = k[1] / z;
+            Jac(1, 2) = -k[1] * y / (z * z);
+        }
+    };
+
+    // Parameters: [fx, fy, cx, cy, k0, k1, k2, k3]
+    template<> struct CameraModel<GeometricCamera::CAM_FISHEYE> {
+        template<typename T>
+        static inline void project(const float* k, const T x, const T y, const T z, T &u, T &v) {
+            const T x2_plus_y2 = x * x + y * y;
+            const T theta = std::atan2(std::sqrt(x2_plus_y2), z);
+            const T psi = std::atan2(y, x);
+
+            const T theta2 = theta * theta;
+            const T theta3 = theta * theta2;
+            const T theta5 = theta3 * theta2;
+            const T theta7 = theta5 * theta2;
+            const T theta9 = theta7 * theta2;
+            const T r = theta + k[4] * theta3 + k[5] * theta5 + k[6] * theta7 + k[7] * theta9;
+
+            u = k[0] * r * std::cos(psi) + k[2];
+            v = k[1] * r * std::sin(psi) + k[3];
+        }
+
+        // Newton step for the angle theta of the ray that is distorted to the radius theta_d
+        static inline float thetaNewtonFix(const float* k, const float theta, const float theta_d) {
+            float theta2 = theta * theta, theta4 = theta2 * theta2, theta6 = theta4 * theta2, theta8 =
+                    theta4 * theta4;
+            float k0_theta2 = k[4] * theta2, k1_theta4 = k[5] * theta4;
+            float k2_theta6 = k[6] * theta6, k3_theta8 = k[7] * theta8;
+            return (theta * (1 + k0_theta2 + k1_theta4 + k2_theta6 + k3_theta8) - theta_d) /
+                   (1 + 3 * k0_theta2 + 5 * k1_theta4 + 7 * k2_theta6 + 9 * k3_theta8);
+        }
+
+        // Newton method to solve for theta with good precision (err ~ e-6)
+        static inline float solveTheta(const float* k, const float precision, const float theta_d) {
+            //Compensate distortion iteratively
+            float theta = theta_d;
+
+            for (int j = 0; j < 10; j++) {
+                float theta_fix = thetaNewtonFix(k, theta, theta_d);
+                theta = theta - theta_fix;
+                if (fabsf(theta_fix) < precision)
+                    break;
+            }
+            return theta;
+        }
+
+        // Distorted radius of the normalized pixel (pwx,pwy)
+        static inline float thetaDistorted(const float pwx, const float pwy) {
+            const float theta_d = sqrtf(pwx * pwx + pwy * pwy);
+            return fminf(fmaxf(-CV_PI / 2.f, theta_d), CV_PI / 2.f);
+        }
+
+        // Ray (x,y,1) of the pixel (u,v)
+        static inline void unproject(const float* k, const float precision, const float u, const float v, float &x, float &y) {
+            const float pwx = (u - k[2]) / k[0];
+            const float pwy = (v - k[3]) / k[1];
+            float scale = 1.f;
+            const float theta_d = thetaDistorted(pwx, pwy);
+
+            if (theta_d > 1e-8)
+                scale = std::tan(solveTheta(k, precision, theta_d)) / theta_d;
+
+            x = pwx * scale;
+            y = pwy * scale;
+        }
+
+        template<typename T>
+        static inline void projectJac(const float* k, const T x, const T y, const T z, Eigen::Matrix<T,2,3> &Jac) {
+            T x2 = x * x, y2 = y * y, z2 = z * z;
+            T r2 = x2 + y2;
+            T r = std::sqrt(r2);
+            T r3 = r2 * r;
+            T theta = std::atan2(r, z);
+
+            T theta2 = theta * theta, theta3 = theta2 * theta;
+            T theta4 = theta2 * theta2, theta5 = theta4 * theta;
+            T theta6 = theta2 * theta4, theta7 = theta6 * theta;
+            T theta8 = theta4 * theta4, theta9 = theta8 * theta;
+
+            T f = theta + theta3 * k[4] + theta5 * k[5] + theta7 * k[6] + theta9 * k[7];
+            T fd = 1 + 3 * k[4] * theta2 + 5 * k[5] * theta4 + 7 * k[6] * theta6 + 9 * k[7] * theta8;
+
+            Jac(0, 0) = k[0] * (fd * z * x2 / (r2 * (r2 + z2)) + f * y2 / r3);
+            Jac(1, 0) = k[1] * (fd * z * y * x / (r2 * (r2 + z2)) - f * y * x / r3);
+
+            Jac(0, 1) = k[0] * (fd * z * y * x / (r2 * (r2 + z2)) - f * y * x / r3);
+            Jac(1, 1) = k[1] * (fd * z * y2 / (r2 * (r2 + z2)) + f * x2 / r3);
+
+            Jac(0, 2) = -k[0] * fd * x / (r2 + z2);
+            Jac(1, 2) = -k[1] * fd * y / (r2 + z2);
+        }
+    };
+
+    // Single point versions for callers that cannot batch their points (g2o edges): the type switch
+    // replaces the virtual call and the kernel is inlined in the caller.
+    template<typename T>
+    inline Eigen::Matrix<T,2,1> ProjectPoint(GeometricCamera* pCamera, const Eigen::Matrix<T,3,1> &p3D) {
+        Eigen::Matrix<T,2,1> res;
+        if(pCamera->GetType() == GeometricCamera::CAM_PINHOLE)
+            CameraModel<GeometricCamera::CAM_PINHOLE>::project(pCamera->getParameters(), p3D[0], p3D[1], p3D[2], res[0], res[1]);
+        else
+            CameraModel<GeometricCamera::CAM_FISHEYE>::project(pCamera->getParameters(), p3D[0], p3D[1], p3D[2], res[0], res[1]);
+        return res;
+    }
+
+    template<typename T>
+    inline Eigen::Matrix<T,2,3> ProjectJac(GeometricCamera* pCamera, const Eigen::Matrix<T,3,1> &p3D) {
+        Eigen::Matrix<T,2,3> Jac;
+        if(pCamera->GetType() == GeometricCamera::CAM_PINHOLE)
+            CameraModel<GeometricCamera::CAM_PINHOLE>::projectJac(pCamera->getParameters(), p3D[0], p3D[1], p3D[2], Jac);
+        else
+            CameraModel<GeometricCamera::CAM_FISHEYE>::projectJac(pCamera->getParameters(), p3D[0], p3D[1], p3D[2], Jac);
+        return Jac;
+    }
+}
+
+
+#endif //CAMERAMODELS_CAMERAMODEL_H
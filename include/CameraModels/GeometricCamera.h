@@ -78,7 +78,13 @@ namespace ORB_SLAM3 {
 
         virtual bool epipolarConstrain(GeometricCamera* otherCamera, const cv::KeyPoint& kp1, const cv::KeyPoint& kp2, const Eigen::Matrix3f& R12, const Eigen::Vector3f& t12, const float sigmaLevel, const float unc) = 0;
 
+        // Batch versions of project and unprojectEig. The camera type is dispatched once for
+        // all the points and the model kernel (CameraModel.h) is inlined in the loop.
+        void projectBatch(const float* pX, const float* pY, const float* pZ, const size_t n, float* pU, float* pV);
+        void unprojectBatch(const cv::KeyPoint* pKeys, const size_t n, Eigen::Vector3f* pRays);
+
         float getParameter(const int i){return mvParameters[i];}
+        const float* getParameters() const {return mvParameters.data();}
         void setParameter(const float p, const size_t i){mvParameters[i] = p;}
 
         size_t size(){return mvParameters.size();}
@@ -36,6 +36,8 @@ namespace ORB_SLAM3 {
     {
         ar & boost::serialization::base_object<GeometricCamera>(*this);
         ar & const_cast<float&>(precision);
+        if(Archive::is_loading::value)
+            BuildUnprojectLUT();
     }
 
     public:
@@ -48,6 +50,7 @@ namespace ORB_SLAM3 {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
+            BuildUnprojectLUT();
         }
 
         KannalaBrandt8(const std::vector<float> _vParameters, const float _precision) : GeometricCamera(_vParameters),
@@ -55,11 +58,13 @@ namespace ORB_SLAM3 {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
+            BuildUnprojectLUT();
         }
         KannalaBrandt8(KannalaBrandt8* pKannala) : GeometricCamera(pKannala->mvParameters), precision(pKannala->precision), mvLappingArea(2,0) ,tvr(nullptr) {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
+            BuildUnprojectLUT();
         }
 
         cv::Point2f project(const cv::Point3f &p3D);
@@ -97,6 +102,9 @@ namespace ORB_SLAM3 {
 
         float GetPrecision(){ return precision;}
 
+        // Unprojection of a batch of keypoints with the radius-to-theta table (same rays as unprojectEig)
+        void UnprojectWithLUT(const cv::KeyPoint* pKeys, const size_t n, Eigen::Vector3f* pRays);
+
         bool IsEqual(GeometricCamera* pCam);
     private:
         const float precision;
@@ -106,6 +114,16 @@ namespace ORB_SLAM3 {
 
         TwoViewReconstruction* tvr;
 
+        // Angle theta of the ray for distorted radii theta_d in [0,pi/2], sampled every pi/2/UNPROJECT_LUT_SIZE.
+        // It depends on k0..k3 only, so it is kept when the image is resized.
+        static const int UNPROJECT_LUT_SIZE = 2048;
+        std::vector<float> mvThetaLUT;
+        float mfLUTInvStep;
+
+        void BuildUnprojectLUT();
+        // Interpolated table value refined with one Newton step
+        float ThetaFromLUT(const float theta_d);
+
         void Triangulate(const cv::Point2f &p1, const cv::Point2f &p2, const Eigen::Matrix<float,3,4> &Tcw1,
                          const Eigen::Matrix<float,3,4> &Tcw2, Eigen::Vector3f &x3D);
     };
@@ -0,0 +1,105 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef EPOCHMANAGER_H
+#define EPOCHMANAGER_H
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace ORB_SLAM3
+{
+
+class MapPoint;
+class KeyFrame;
+class Atlas;
+
+// Deferred release of culled map points and keyframes (quiescent-state based reclamation).
+// Each thread that keeps map pointers (tracking, local mapping, loop closing, global BA, viewer) is a
+// participant and calls Quiescent() where it holds no pointer to a bad object obtained earlier. The
+// global epoch only advances once every active participant has reported in the current one.
+// A retired object goes through two grace periods of three epochs: after the first one the links that
+// other keyframes and maps still keep to it are erased (only the keyframes that may hold them are visited),
+// after the second one it is released. Map points
+// are deleted; keyframes keep their pose and spanning tree data (the trajectory is recovered through
+// them) and release their descriptors, bag of words and point matches.
+class EpochManager
+{
+public:
+    EpochManager();
+
+    // Returns the id of the new participant
+    int Register();
+    void Unregister(const int nId);
+
+    // The participant holds no pointer to an object retired before this call
+    void Quiescent(const int nId);
+
+    // Called once the object is bad and erased from its map. The keyframes that observed the point are the
+    // only old keyframes that may still link to it
+    void Retire(MapPoint* pMP, const std::vector<KeyFrame*> &vpObservers);
+    void Retire(KeyFrame* pKF);
+
+    // The keyframe was inserted in a map or took a match to a bad point, so it may link to a point retired
+    // before. Only recorded while some retired points are waiting to be unlinked
+    void AddLinkCandidate(KeyFrame* pKF);
+
+    // Advance the epoch if possible and process the retired objects whose grace period is over.
+    // Returns the bytes released in this call
+    size_t Reclaim(Atlas* pAtlas);
+
+    size_t GetReclaimedBytes();
+    size_t GetPendingObjects();
+
+    static const int MAX_PARTICIPANTS = 16;
+
+protected:
+    struct Batch
+    {
+        unsigned long nEpoch;
+        bool bUnlinked;
+        std::vector<MapPoint*> vpMapPoints;
+        std::vector<KeyFrame*> vpKeyFrames;
+        // Keyframes to check for matches to the retired points
+        std::vector<KeyFrame*> vpCandidateKFs;
+    };
+
+    Batch& CurrentBatch();
+    void TryAdvance();
+    void Unlink(Batch &batch, Atlas* pAtlas);
+    size_t Release(Batch &batch);
+
+    std::atomic<unsigned long> mnGlobalEpoch;
+    std::atomic<unsigned long> mvnLocalEpoch[MAX_PARTICIPANTS];
+    std::atomic<bool> mvbActive[MAX_PARTICIPANTS];
+
+    std::deque<Batch> mdBatches;
+    std::mutex mMutexRetired;
+
+    // Only one thread processes the batches at a time
+    std::mutex mMutexReclaim;
+
+    size_t mnReclaimedBytes;
+};
+
+} //namespace ORB_SLAM
+
+#endif // EPOCHMANAGER_H
@@ -0,0 +1,57 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FASTDETECTOR_H
+#define FASTDETECTOR_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+namespace ORB_SLAM3
+{
+
+// FAST-9 (16 pixel circle) corner detector working on a whole pyramid level at once.
+// Scores are computed once per level with the lowest threshold and cells are then read back
+// for any higher threshold, giving the same keypoints as cv::FAST run cell by cell.
+class FASTdetector
+{
+public:
+
+    enum Backend {SCALAR=0, SSE2=1, AVX2=2};
+
+    // Score the pixels of img in [minX,maxX)x[minY,maxY). Pixels that are not corners for
+    // threshold th are set to 0, corners keep the score used by cv::FAST for non-maximum suppression.
+    // The region must leave 3 pixels to the image borders. Scores outside the region are not written.
+    static void ComputeScores(const cv::Mat &img, cv::Mat &scores, int th,
+                              const int minX, const int maxX, const int minY, const int maxY);
+
+    // Equivalent to cv::FAST(img.rowRange(iniY,maxY).colRange(iniX,maxX),vKeys,th,true) on the scores
+    // of ComputeScores (computed with a threshold lower or equal than th). Keypoints are given relative
+    // to (iniX,iniY) and appended in raster order.
+    static void DetectInCell(const cv::Mat &scores, const int th, const int iniX, const int iniY,
+                             const int maxX, const int maxY, std::vector<cv::KeyPoint> &vKeys);
+
+    // Instruction set selected at runtime for ComputeScores.
+    static Backend GetBackend();
+    static const char* GetBackendName();
+};
+
+} //namespace ORB_SLAM
+
+#endif // FASTDETECTOR_H
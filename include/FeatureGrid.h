@@ -0,0 +1,68 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FEATUREGRID_H
+#define FEATUREGRID_H
+
+#include <vector>
+
+#include <boost/serialization/vector.hpp>
+
+#include "SharedVector.h"
+
+namespace ORB_SLAM3
+{
+
+// Keypoint indices bucketed in a grid of cells, stored as one index array sorted by cell and
+// the offset of every cell in it. Copies of a grid share both arrays.
+class FeatureGrid
+{
+    friend class boost::serialization::access;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & mnCols;
+        ar & mnRows;
+        ar & const_cast<std::vector<int>&>(mvCellStart.get());
+        ar & const_cast<std::vector<int>&>(mvIndices.get());
+    }
+
+public:
+    FeatureGrid();
+
+    // Build the grid from the cell of every keypoint (ix*nRows+iy, or -1 for keypoints out of the grid).
+    // Indices inside a cell are sorted in increasing order.
+    void Assign(const int nCols, const int nRows, const std::vector<int> &vCellOfKey);
+
+    bool empty() const {return mvCellStart.empty();}
+
+    // Indices of the keypoints in cell (ix,iy), in [CellBegin,CellEnd).
+    const int* CellBegin(const int ix, const int iy) const {return mvIndices.get().data() + mvCellStart[ix*mnRows+iy];}
+    const int* CellEnd(const int ix, const int iy) const {return mvIndices.get().data() + mvCellStart[ix*mnRows+iy+1];}
+
+private:
+    int mnCols, mnRows;
+
+    SharedVector<int> mvCellStart;
+    SharedVector<int> mvIndices;
+};
+
+} //namespace ORB_SLAM
+
+#endif // FEATUREGRID_H
@@ -32,6 +32,8 @@
 
 #include "Converter.h"
 #include "Settings.h"
+#include "FeatureGrid.h"
+#include "SharedVector.h"
 
 #include <mutex>
 #include <opencv2/opencv.hpp>
@@ -49,6 +51,9 @@ class KeyFrame;
 class ConstraintPoseImu;
 class GeometricCamera;
 class ORBextractor;
+class ThreadPool;
+class UndistortionLUT;
+class MapPointSnapshot;
 
 class Frame
 {
@@ -73,6 +78,11 @@ public:
     // Extract ORB on the image. 0 for left image and 1 for right image.
     void ExtractORB(int flag, const cv::Mat &im, const int x0, const int x1);
 
+    // Extract ORB on both stereo images at the same time, the right one in the extraction pool.
+    // (x0,x1) are the lapping areas of each image.
+    void ExtractORBStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const int x0Left, const int x1Left,
+                          const int x0Right, const int x1Right);
+
     // Compute Bag of Words representation.
     void ComputeBoW();
 
@@ -102,6 +112,10 @@ public:
     // and fill variables of the MapPoint to be used by the tracking
     bool isInFrustum(MapPoint* pMP, float viewingCosLimit);
 
+    // Check the frustum of all the snapshot points at once. Fills the tracking data of the visible points
+    // (skipping those already seen in this frame and the bad ones) and returns them in vpInView.
+    int isInFrustum(MapPointSnapshot &points, float viewingCosLimit, std::vector<MapPoint*> &vpInView);
+
     bool ProjectPointDistort(MapPoint* pMP, cv::Point2f &kp, float &u, float &v);
 
     Eigen::Vector3f inRefCoordinates(Eigen::Vector3f pCw);
@@ -195,6 +209,12 @@ public:
     // Feature extractor. The right is used only in the stereo case.
     ORBextractor* mpORBextractorLeft, *mpORBextractorRight;
 
+    // Workers shared by all frames for the stereo extraction (owned by the System).
+    static ThreadPool* mpExtractorPool;
+
+    // Precomputed undistortion of the keypoints (owned by the Tracking, NULL to undistort them with OpenCV).
+    static UndistortionLUT* mpUndistortionLUT;
+
     // Frame timestamp.
     double mTimeStamp;
 
@@ -225,20 +245,22 @@ public:
     // Vector of keypoints (original for visualization) and undistorted (actually used by the system).
     // In the stereo case, mvKeysUn is redundant as images must be rectified.
     // In the RGB-D case, RGB images can be distorted.
-    std::vector<cv::KeyPoint> mvKeys, mvKeysRight;
-    std::vector<cv::KeyPoint> mvKeysUn;
+    // Features are shared with the copies of the frame and with its KeyFrame.
+    SharedVector<cv::KeyPoint> mvKeys, mvKeysRight;
+    SharedVector<cv::KeyPoint> mvKeysUn;
 
     // Corresponding stereo coordinate and depth for each keypoint.
     std::vector<MapPoint*> mvpMapPoints;
     // "Monocular" keypoints have a negative value.
-    std::vector<float> mvuRight;
-    std::vector<float> mvDepth;
+    SharedVector<float> mvuRight;
+    SharedVector<float> mvDepth;
 
     // Bag of Words Vector structures.
     DBoW2::BowVector mBowVec;
     DBoW2::FeatureVector mFeatVec;
 
-    // ORB descriptor, each row associated to a keypoint.
+    // ORB descriptor, each row associated to a keypoint. Not modified once the frame is built,
+    // so copies share the same data.
     cv::Mat mDescriptors, mDescriptorsRight;
 
     // MapPoints associated to keypoints, NULL pointer if no association.
@@ -249,7 +271,7 @@ public:
     // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
     static float mfGridElementWidthInv;
     static float mfGridElementHeightInv;
-    std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    FeatureGrid mGrid;
 
     IMU::Bias mPredBias;
 
@@ -300,6 +322,8 @@ public:
 
 #ifdef REGISTER_TIMES
     double mTimeORB_Ext;
+    double mTimeORB_ExtLeft;
+    double mTimeORB_ExtRight;
     double mTimeStereoMatch;
 #endif
 
@@ -333,15 +357,12 @@ public:
     //For stereo matching
     std::vector<int> mvLeftToRightMatch, mvRightToLeftMatch;
 
-    //For stereo fisheye matching
-    static cv::BFMatcher BFmatcher;
-
     //Triangulated stereo observations using as reference the left camera. These are
     //computed during ComputeStereoFishEyeMatches
     std::vector<Eigen::Vector3f> mvStereo3Dpoints;
 
     //Grid for the right image
-    std::vector<std::size_t> mGridRight[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    FeatureGrid mGridRight;
 
     Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
 
@@ -31,8 +31,11 @@
 
 #include "GeometricCamera.h"
 #include "SerializationUtils.h"
+#include "SeqLock.h"
 
 #include <mutex>
+#include <unordered_set>
+#include <functional>
 
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/vector.hpp>
@@ -46,6 +49,7 @@ class Map;
 class MapPoint;
 class Frame;
 class KeyFrameDatabase;
+class EpochManager;
 
 class GeometricCamera;
 
@@ -123,8 +127,8 @@ class KeyFrame
         // KeyPoints
         serializeVectorKeyPoints<Archive>(ar, mvKeys, version);
         serializeVectorKeyPoints<Archive>(ar, mvKeysUn, version);
-        ar & const_cast<vector<float>& >(mvuRight);
-        ar & const_cast<vector<float>& >(mvDepth);
+        ar & const_cast<vector<float>& >(mvuRight.get());
+        ar & const_cast<vector<float>& >(mvDepth.get());
         serializeMatrix<Archive>(ar,mDescriptors,version);
         // BOW
         ar & mBowVec;
@@ -205,6 +209,8 @@ public:
 
     Sophus::SE3f GetPoseInverse();
     Eigen::Vector3f GetCameraCenter();
+    // Changes whenever the pose is set (lets callers keep values derived from the pose)
+    unsigned int GetPoseVersion();
 
     Eigen::Vector3f GetImuPosition();
     Eigen::Matrix3f GetImuRotation();
@@ -223,9 +229,14 @@ public:
 
     void UpdateConnections(bool upParent=true);
     void UpdateBestCovisibles();
+    // Change the number of map points seen by this keyframe and pKF (called by the map points
+    // when an observation is added or erased)
+    void UpdateCovisibility(KeyFrame* pKF, const int nDelta);
     std::set<KeyFrame *> GetConnectedKeyFrames();
     std::vector<KeyFrame* > GetVectorCovisibleKeyFrames();
     std::vector<KeyFrame*> GetBestCovisibilityKeyFrames(const int &N);
+    // Fill vpKFs instead of returning a new vector (no allocation once it has enough capacity)
+    void GetBestCovisibilityKeyFrames(const int &N, std::vector<KeyFrame*> &vpKFs);
     std::vector<KeyFrame*> GetCovisiblesByWeight(const int &w);
     int GetWeight(KeyFrame* pKF);
 
@@ -234,6 +245,7 @@ public:
     void EraseChild(KeyFrame* pKF);
     void ChangeParent(KeyFrame* pKF);
     std::set<KeyFrame*> GetChilds();
+    void GetChilds(std::vector<KeyFrame*> &vpChilds);
     KeyFrame* GetParent();
     bool hasChild(KeyFrame* pKF);
     void SetFirstConnection(bool bFirst);
@@ -251,6 +263,8 @@ public:
     void AddMapPoint(MapPoint* pMP, const size_t &idx);
     void EraseMapPointMatch(const int &idx);
     void EraseMapPointMatch(MapPoint* pMP);
+    // Erase every match to one of the given points
+    void EraseMapPointMatches(const std::unordered_set<MapPoint*> &spMPs);
     void ReplaceMapPointMatch(const int &idx, MapPoint* pMP);
     std::set<MapPoint*> GetMapPoints();
     std::vector<MapPoint*> GetMapPointMatches();
@@ -272,6 +286,10 @@ public:
     void SetBadFlag();
     bool isBad();
 
+    // Release descriptors, bag of words and point matches of a bad keyframe that no thread can reach
+    // anymore. Pose and spanning tree data are kept. Returns the bytes released
+    size_t ReleaseFeatures();
+
     // Compute Scene Depth (q=2 median). Used in monocular.
     float ComputeSceneMedianDepth(const int q);
 
@@ -309,6 +327,9 @@ public:
 public:
 
     static long unsigned int nNextId;
+
+    // Receives the keyframes when they become bad (NULL if culled keyframes are never released)
+    static EpochManager* mpEpochManager;
     long unsigned int mnId;
     const long unsigned int mnFrameId;
 
@@ -377,12 +398,12 @@ public:
     // Number of KeyPoints
     const int N;
 
-    // KeyPoints, stereo coordinate and descriptors (all associated by an index)
-    const std::vector<cv::KeyPoint> mvKeys;
-    const std::vector<cv::KeyPoint> mvKeysUn;
-    const std::vector<float> mvuRight; // negative value for monocular points
-    const std::vector<float> mvDepth; // negative value for monocular points
-    const cv::Mat mDescriptors;
+    // KeyPoints, stereo coordinate and descriptors (all associated by an index), shared with the Frame
+    const SharedVector<cv::KeyPoint> mvKeys;
+    const SharedVector<cv::KeyPoint> mvKeysUn;
+    const SharedVector<float> mvuRight; // negative value for monocular points
+    const SharedVector<float> mvDepth; // negative value for monocular points
+    cv::Mat mDescriptors; // only modified by ReleaseFeatures
 
     //BoW
     DBoW2::BowVector mBowVec;
@@ -434,6 +455,10 @@ protected:
 
     // IMU position
     Eigen::Vector3f mOwb;
+
+    // Copy of Tcw, Twc, Rcw and Owb for lock-free readers, written by SetPose under mMutexPose
+    enum {POSE_TCW=0, POSE_TWC=7, POSE_RCW=14, POSE_OWB=23, POSE_SIZE=26};
+    SeqLock<POSE_SIZE> mPoseSeq;
     // Velocity (Only used for inertial SLAM)
     Eigen::Vector3f mVw;
     bool mbHasVelocity;
@@ -455,11 +480,14 @@ protected:
     ORBVocabulary* mpORBvocabulary;
 
     // Grid over the image to speed up feature matching
-    std::vector< std::vector <std::vector<size_t> > > mGrid;
+    FeatureGrid mGrid;
 
     std::map<KeyFrame*,int> mConnectedKeyFrameWeights;
-    std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;
-    std::vector<int> mvOrderedWeights;
+    // Connected keyframes by decreasing weight. A bad keyframe can stay until this keyframe updates its
+    // connections, the getters skip it
+    std::set<std::pair<int,KeyFrame*>, std::greater<std::pair<int,KeyFrame*> > > msOrderedConnections;
+    // The first N good keyframes of msOrderedConnections with weight at least w
+    void GetGoodConnections(const int N, const int w, std::vector<KeyFrame*> &vpKFs);
     // For save relation without pointer, this is necessary for save/load function
     std::map<long unsigned int, int> mBackupConnectedKeyFrameIdWeights;
 
@@ -501,6 +529,11 @@ protected:
     std::mutex mMutexFeatures;
     std::mutex mMutexMap;
 
+    // Map points shared with every other keyframe, up to date with the observations. UpdateConnections
+    // builds the covisibility graph from it without going through the points
+    std::map<KeyFrame*,int> mCovisibilityCounter;
+    std::mutex mMutexCovisibility;
+
 public:
     GeometricCamera* mpCamera, *mpCamera2;
 
@@ -511,11 +544,11 @@ public:
     Sophus::SE3f GetRelativePoseTlr();
 
     //KeyPoints in the right image (for stereo fisheye, coordinates are needed)
-    const std::vector<cv::KeyPoint> mvKeysRight;
+    const SharedVector<cv::KeyPoint> mvKeysRight;
 
     const int NLeft, NRight;
 
-    std::vector< std::vector <std::vector<size_t> > > mGridRight;
+    FeatureGrid mGridRight;
 
     Sophus::SE3<float> GetRightPose();
     Sophus::SE3<float> GetRightPoseInverse();
@@ -26,6 +26,7 @@
 #include "Tracking.h"
 #include "KeyFrameDatabase.h"
 #include "Settings.h"
+#include "EpochManager.h"
 
 #include <mutex>
 
@@ -37,6 +38,8 @@ class System;
 class Tracking;
 class LoopClosing;
 class Atlas;
+class ORBmatcher;
+class ThreadPool;
 
 class LocalMapping
 {
@@ -48,6 +51,12 @@ public:
 
     void SetTracker(Tracking* pTracker);
 
+    // Workers used to triangulate with several neighbor keyframes at the same time (NULL to do it serially)
+    void SetThreadPool(ThreadPool* pPool);
+
+    // Deferred release of culled keyframes and points (owned by the System, NULL if disabled)
+    void SetEpochManager(EpochManager* pEpochManager);
+
     // Main function
     void Run();
 
@@ -135,6 +144,17 @@ protected:
     void ProcessNewKeyFrame();
     void CreateNewMapPoints();
 
+    // MapPoint triangulated from a match between the current keyframe and a neighbor
+    struct NewMapPoint
+    {
+        Eigen::Vector3f x3D;
+        size_t idx1;
+        size_t idx2;
+    };
+
+    // Match the current keyframe with pKF2 and triangulate the matches. The map is not modified.
+    void TriangulateWithNeighbor(KeyFrame* pKF2, ORBmatcher &matcher, std::vector<NewMapPoint> &vNewMapPoints);
+
     void MapPointCulling();
     void SearchInNeighbors();
     void KeyFrameCulling();
@@ -161,6 +181,11 @@ protected:
     LoopClosing* mpLoopCloser;
     Tracking* mpTracker;
 
+    ThreadPool* mpThreadPool;
+
+    EpochManager* mpEpochManager;
+    int mnEpochId;
+
     std::list<KeyFrame*> mlNewKeyFrames;
 
     KeyFrame* mpCurrentKeyFrame;
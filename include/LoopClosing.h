@@ -27,6 +27,7 @@
 #include "Tracking.h"
 
 #include "KeyFrameDatabase.h"
+#include "EpochManager.h"
 
 #include <boost/algorithm/string.hpp>
 #include <thread>
@@ -58,6 +59,9 @@ public:
 
     void SetLocalMapper(LocalMapping* pLocalMapper);
 
+    // Deferred release of culled keyframes and points (owned by the System, NULL if disabled)
+    void SetEpochManager(EpochManager* pEpochManager);
+
     // Main function
     void Run();
 
@@ -219,6 +223,9 @@ protected:
     std::mutex mMutexGBA;
     std::thread* mpThreadGBA;
 
+    EpochManager* mpEpochManager;
+    int mnEpochId;
+
     // Fix scale in the stereo/RGB-D case
     bool mbFixScale;
 
@@ -22,8 +22,11 @@
 
 #include "MapPoint.h"
 #include "KeyFrame.h"
+#include "SlotMap.h"
+#include "VoxelIndex.h"
 
 #include <set>
+#include <unordered_set>
 #include <pangolin/pangolin.h>
 #include <mutex>
 
@@ -78,6 +81,7 @@ public:
     void EraseMapPoint(MapPoint* pMP);
     void EraseKeyFrame(KeyFrame* pKF);
     void SetReferenceMapPoints(const std::vector<MapPoint*> &vpMPs);
+    void EraseReferenceMapPoints(const std::unordered_set<MapPoint*> &spMPs);
     void InformNewBigChange();
     int GetLastBigChangeIdx();
 
@@ -85,6 +89,19 @@ public:
     std::vector<MapPoint*> GetAllMapPoints();
     std::vector<MapPoint*> GetReferenceMapPoints();
 
+    // Shared read-only views of the keyframes and points, only copied again after the map changes
+    std::shared_ptr<const std::vector<KeyFrame*> > GetKeyFramesSnapshot();
+    std::shared_ptr<const std::vector<MapPoint*> > GetMapPointsSnapshot();
+
+    // Spatial queries on the map points: closer than r to a position, in view of a camera (inside the image
+    // bounds and closer than maxDepth) and the k nearest to a position
+    std::vector<MapPoint*> GetMapPointsInRadius(const Eigen::Vector3f &pos, const float r);
+    std::vector<MapPoint*> GetMapPointsInFrustum(const Sophus::SE3f &Tcw, GeometricCamera* pCamera, const float minX, const float maxX,
+                                                 const float minY, const float maxY, const float maxDepth);
+    std::vector<MapPoint*> GetNearestMapPoints(const Eigen::Vector3f &pos, const int k);
+    // Called by MapPoint::SetWorldPos
+    void UpdateMapPointPosition(MapPoint* pMP, const Eigen::Vector3f &pos);
+
     long unsigned int MapPointsInMap();
     long unsigned  KeyFramesInMap();
 
@@ -159,8 +176,14 @@ protected:
 
     long unsigned int mnId;
 
-    std::set<MapPoint*> mspMapPoints;
-    std::set<KeyFrame*> mspKeyFrames;
+    SlotMap<MapPoint> mspMapPoints;
+    SlotMap<KeyFrame> mspKeyFrames;
+
+    // Positions of the map points hashed in voxels. It has its own mutex: points are moved while
+    // mMutexMap is held (ApplyScaledRotation)
+    VoxelIndex<MapPoint> mPointIndex;
+    std::mutex mMutexPointIndex;
+    static const float POINT_INDEX_VOXEL_SIZE;
 
     // Save/load, the set structure is broken in libboost 1.58 for ubuntu 16.04, a vector is serializated
     std::vector<MapPoint*> mvpBackupMapPoints;
@@ -24,6 +24,8 @@
 #include "Frame.h"
 #include "Map.h"
 #include "Converter.h"
+#include "ObservationList.h"
+#include "SeqLock.h"
 
 #include "SerializationUtils.h"
 
@@ -40,6 +42,7 @@ namespace ORB_SLAM3
 class KeyFrame;
 class Map;
 class Frame;
+class EpochManager;
 
 class MapPoint
 {
@@ -117,9 +120,23 @@ public:
     Eigen::Vector3f GetNormal();
     void SetNormalVector(const Eigen::Vector3f& normal);
 
+    // Position, normal, mfMinDistance and mfMaxDistance read as one consistent copy
+    void GetGeometry(Eigen::Vector3f &Pos, Eigen::Vector3f &Normal, float &minDistance, float &maxDistance);
+
     KeyFrame* GetReferenceKeyFrame();
 
-    std::map<KeyFrame*,std::tuple<int,int>> GetObservations();
+    ObservationList GetObservations();
+
+    // Call f(pKF, leftIndex, rightIndex) for each observation without copying them. It runs under
+    // the features mutex, so f must not lock other map mutexes or call back into this point
+    template<class F>
+    void ForEachObservation(F f)
+    {
+        std::unique_lock<std::mutex> lock(mMutexFeatures);
+        for(ObservationList::const_iterator it=mObservations.begin(), itend=mObservations.end(); it!=itend; it++)
+            f(it->first,std::get<0>(it->second),std::get<1>(it->second));
+    }
+
     int Observations();
 
     void AddObservation(KeyFrame* pKF,int idx);
@@ -145,6 +162,9 @@ public:
 
     cv::Mat GetDescriptor();
 
+    // Approximate heap bytes owned by the point
+    size_t GetMemoryUsage();
+
     void UpdateNormalAndDepth();
 
     float GetMinDistanceInvariance();
@@ -205,6 +225,9 @@ public:
 
     static std::mutex mGlobalMutex;
 
+    // Receives the points when they become bad (NULL if culled points are never released)
+    static EpochManager* mpEpochManager;
+
     unsigned int mnOriginMapId;
 
 protected:    
@@ -212,8 +235,51 @@ protected:
      // Position in absolute coordinates
      Eigen::Vector3f mWorldPos;
 
+     // Copy of position, normal and scale distances for lock-free readers. Written under mMutexPos
+     // by PublishGeometry() whenever one of them changes
+     enum {GEOM_POS=0, GEOM_NORMAL=3, GEOM_MIN_DIST=6, GEOM_MAX_DIST=7, GEOM_SIZE=8};
+     SeqLock<GEOM_SIZE> mGeometry;
+     void PublishGeometry();
+
      // Keyframes observing the point and associated index in keyframe
-     std::map<KeyFrame*,std::tuple<int,int> > mObservations;
+     ObservationList mObservations;
+
+     // Keep the covisibility counters of the keyframes up to date with the observations: pKF gains
+     // or loses the point shared with the keyframes in obs, or all keyframes in obs stop sharing it
+     static void UpdateCovisibility(KeyFrame* pKF, const ObservationList &obs, const int nDelta);
+     static void EraseCovisibility(const ObservationList &obs);
+
+     static std::vector<KeyFrame*> ObserverKeyFrames(const ObservationList &obs);
+
+     // Descriptors of the observations and the sorted distances of each one to all of them. Only the
+     // observations added or erased since the last ComputeDistinctiveDescriptors are processed
+     struct DescriptorEntry
+     {
+         KeyFrame* pKF;
+         int idx;
+         cv::Mat descriptor;
+         std::vector<int> vSortedDistances;
+     };
+     std::vector<DescriptorEntry> mvDescriptorCache;
+     void AddCachedDescriptor(KeyFrame* pKF, const int idx);
+     void EraseCachedDescriptor(const size_t i);
+
+     // Viewing directions summed in mNormalSum. They are reused while the position of the point and the
+     // pose of their keyframe do not change
+     struct NormalEntry
+     {
+         KeyFrame* pKF;
+         int idx;
+         unsigned int nPoseVersion;
+         Eigen::Vector3f direction;
+     };
+     std::vector<NormalEntry> mvNormalCache;
+     Eigen::Vector3f mNormalCachePos;
+     Eigen::Vector3f mNormalSum;
+
+     // Serializes the updates of both caches
+     std::mutex mMutexCache;
+     void ClearCaches();
      // For save relation without pointer, this is necessary for save/load function
      std::map<long unsigned int, int> mBackupObservationsId1;
      std::map<long unsigned int, int> mBackupObservationsId2;
@@ -0,0 +1,63 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MAPPOINTSNAPSHOT_H
+#define MAPPOINTSNAPSHOT_H
+
+#include <vector>
+
+namespace ORB_SLAM3
+{
+
+class MapPoint;
+
+// Positions, normals and scale invariance distances of a set of map points copied into separate
+// arrays, so that the frustum checks of a frame run over all of them without locking each point.
+class MapPointSnapshot
+{
+public:
+    // Frustum checks of the points for one camera of a frame (filled by Frame::isInFrustum)
+    struct View
+    {
+        void resize(const size_t n);
+
+        std::vector<float> mvXc, mvYc, mvZc;
+        std::vector<float> mvU, mvV;
+        std::vector<float> mvDepth, mvDist, mvViewCos;
+        std::vector<unsigned char> mvbInView;
+    };
+
+    // Copy the geometry of the points, reading each of them once.
+    void Assign(const std::vector<MapPoint*> &vpMPs);
+
+    size_t size() const {return mvpMapPoints.size();}
+
+    std::vector<MapPoint*> mvpMapPoints;
+    std::vector<float> mvX, mvY, mvZ;
+    std::vector<float> mvNx, mvNy, mvNz;
+
+    // mfMinDistance and mfMaxDistance of the points (the invariance region is [0.8*min,1.2*max])
+    std::vector<float> mvMinDistance, mvMaxDistance;
+
+    View mLeft, mRight;
+};
+
+} //namespace ORB_SLAM
+
+#endif // MAPPOINTSNAPSHOT_H
@@ -27,6 +27,8 @@
 namespace ORB_SLAM3
 {
 
+class ThreadPool;
+
 class ExtractorNode
 {
 public:
@@ -46,8 +48,11 @@ public:
     
     enum {HARRIS_SCORE=0, FAST_SCORE=1 };
 
+    // How the FAST corners of a level are spread over the image
+    enum {OCTTREE_DISTRIBUTION=0, GRID_DISTRIBUTION=1};
+
     ORBextractor(int nfeatures, float scaleFactor, int nlevels,
-                 int iniThFAST, int minThFAST);
+                 int iniThFAST, int minThFAST, int distribution=OCTTREE_DISTRIBUTION);
 
     ~ORBextractor(){}
 
@@ -80,14 +85,25 @@ public:
         return mvInvLevelSigma2;
     }
 
+    // Extract the pyramid levels in parallel on the given pool (not owned).
+    // With NULL (default) levels are processed sequentially.
+    void inline SetThreadPool(ThreadPool* pPool){
+        mpThreadPool = pPool;
+    }
+
     std::vector<cv::Mat> mvImagePyramid;
 
 protected:
 
+    void AllocatePyramid(const cv::Size& imageSize);
     void ComputePyramid(cv::Mat image);
     void ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);    
+    void ComputeKeyPointsLevel(const int level, std::vector<cv::KeyPoint>& keypoints);
     std::vector<cv::KeyPoint> DistributeOctTree(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
                                            const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level);
+    // Bucket the keypoints in a grid of about nFeatures cells and keep the strongest ones of each cell
+    std::vector<cv::KeyPoint> DistributeGrid(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
+                                             const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level);
 
     void ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);
     std::vector<cv::Point> pattern;
@@ -97,15 +113,35 @@ protected:
     int nlevels;
     int iniThFAST;
     int minThFAST;
+    int mnDistribution;
 
     std::vector<int> mnFeaturesPerLevel;
 
+    // Bordered buffers holding mvImagePyramid and blurred levels for the descriptors.
+    // Allocated for the size of the first image and reused between frames.
+    cv::Size mPyramidImageSize;
+    std::vector<cv::Mat> mvPyramidBuffers;
+    std::vector<cv::Mat> mvBlurredPyramid;
+
+    // FAST scores of each pyramid level, reused between frames
+    std::vector<cv::Mat> mvFASTScores;
+
+    // Per level scratch buffers reused between frames
+    std::vector<std::vector<cv::KeyPoint> > mvvToDistributeKeys;
+    std::vector<std::vector<int> > mvvLevelRows;
+    std::vector<std::vector<int> > mvvGridCellStart;
+    std::vector<std::vector<int> > mvvGridCellFill;
+    std::vector<std::vector<int> > mvvGridKeyCell;
+    std::vector<std::vector<const cv::KeyPoint*> > mvvpGridKeys;
+
     std::vector<int> umax;
 
     std::vector<float> mvScaleFactor;
     std::vector<float> mvInvScaleFactor;    
     std::vector<float> mvLevelSigma2;
     std::vector<float> mvInvLevelSigma2;
+
+    ThreadPool* mpThreadPool;
 };
 
 } //namespace ORB_SLAM
@@ -28,6 +28,7 @@
 #include"MapPoint.h"
 #include"KeyFrame.h"
 #include"Frame.h"
+#include"ThreadPool.h"
 
 
 namespace ORB_SLAM3
@@ -41,10 +42,25 @@ namespace ORB_SLAM3
 
         // Computes the Hamming distance between two ORB descriptors
         static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
+        static int DescriptorDistance(const uchar* a, const uchar* b);
+
+        // Hamming distances from the descriptor pQuery to the rows pIdx[0..n) of descriptors
+        static void DescriptorDistances(const uchar* pQuery, const cv::Mat &descriptors, const int* pIdx, const int n, int* pDist);
+
+        // Hamming distances from the descriptor pQuery to n descriptors stored one after another (32 bytes each)
+        static void DescriptorDistances(const uchar* pQuery, const uchar* pBlock, const int n, int* pDist);
+
+        // Best and second best distances from pQuery to n descriptors stored one after another.
+        // Returns the position of the best one (-1 if n is 0), ties keep the first one.
+        static int BestDescriptorDistances(const uchar* pQuery, const uchar* pBlock, const int n, int &bestDist, int &bestDist2);
+
+        // Instruction set used for the Hamming distances
+        static const char* GetDistanceBackendName();
 
         // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
         // Used to track the local map (Tracking)
-        int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th=3, const bool bFarPoints = false, const float thFarPoints = 50.0f);
+        // If a pool is given the MapPoints are split among its workers, the matches are the same as in the serial search.
+        int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th=3, const bool bFarPoints = false, const float thFarPoints = 50.0f, ThreadPool* pPool = NULL);
 
         // Project MapPoints tracked in last frame into the current frame and search matches.
         // Used to track from previous frame (Tracking)
@@ -96,6 +112,14 @@ namespace ORB_SLAM3
     protected:
         float RadiusByViewingCos(const float &viewCos);
 
+        int SearchByProjectionParallel(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th, const bool bFarPoints, const float thFarPoints, ThreadPool* pPool);
+
+        // Local map search of a single MapPoint. The frame is not modified, the keypoints to assign to pMP
+        // are written in pSlots (at most 4) and their number returned. If pvArea is given, the keypoints
+        // whose assignment can change the result are appended to it.
+        int MatchLocalMapPoint(const Frame &F, MapPoint* pMP, const float th, const bool bFarPoints, const float thFarPoints,
+                               std::vector<int> &vCandidates, std::vector<int> &vDistances, std::vector<size_t>* pvArea, int* pSlots);
+
         void ComputeThreeMaxima(std::vector<int>* histo, const int L, int &ind1, int &ind2, int &ind3);
 
         float mfNNratio;
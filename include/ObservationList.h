@@ -0,0 +1,100 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OBSERVATIONLIST_H
+#define OBSERVATIONLIST_H
+
+#include <tuple>
+#include <algorithm>
+
+#include <boost/container/small_vector.hpp>
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+
+// Observations of a MapPoint as (KeyFrame, <left index, right index>) records in a flat array, with
+// room for the usual number of them inline so that copies do not allocate. Records keep the order in
+// which the keyframes were added. The first/second names match the std::map the callers iterated before.
+class ObservationList
+{
+public:
+    struct Observation
+    {
+        Observation() {}
+        Observation(KeyFrame* pKF, const std::tuple<int,int> &indexes): first(pKF), second(indexes) {}
+
+        KeyFrame* first;
+        std::tuple<int,int> second;
+    };
+
+    // Records stored without a heap allocation
+    static const size_t INLINE_CAPACITY = 8;
+
+    typedef boost::container::small_vector<Observation,INLINE_CAPACITY> Storage;
+    typedef Storage::iterator iterator;
+    typedef Storage::const_iterator const_iterator;
+
+    iterator begin() {return mvObs.begin();}
+    iterator end() {return mvObs.end();}
+    const_iterator begin() const {return mvObs.begin();}
+    const_iterator end() const {return mvObs.end();}
+
+    size_t size() const {return mvObs.size();}
+    bool empty() const {return mvObs.empty();}
+    void clear() {mvObs.clear();}
+
+    iterator find(KeyFrame* pKF)
+    {
+        return std::find_if(mvObs.begin(),mvObs.end(),[pKF](const Observation &obs){return obs.first==pKF;});
+    }
+
+    const_iterator find(KeyFrame* pKF) const
+    {
+        return std::find_if(mvObs.begin(),mvObs.end(),[pKF](const Observation &obs){return obs.first==pKF;});
+    }
+
+    size_t count(KeyFrame* pKF) const {return find(pKF)!=end() ? 1 : 0;}
+
+    // Replace the indexes of pKF, or append it if it is not observed yet
+    void set(KeyFrame* pKF, const std::tuple<int,int> &indexes)
+    {
+        iterator it = find(pKF);
+        if(it!=end())
+            it->second = indexes;
+        else
+            mvObs.push_back(Observation(pKF,indexes));
+    }
+
+    // Remove pKF keeping the order of the rest
+    void erase(KeyFrame* pKF)
+    {
+        iterator it = find(pKF);
+        if(it!=end())
+            mvObs.erase(it);
+    }
+
+private:
+    Storage mvObs;
+};
+
+} //namespace ORB_SLAM
+
+#endif // OBSERVATIONLIST_H
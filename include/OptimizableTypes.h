@@ -25,6 +25,7 @@
 
 #include <Eigen/Geometry>
 #include <include/CameraModels/GeometricCamera.h>
+#include <include/CameraModels/CameraModel.h>
 
 
 namespace ORB_SLAM3 {
@@ -41,7 +42,7 @@ public:
     void computeError()  {
         const g2o::VertexSE3Expmap* v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[0]);
         Eigen::Vector2d obs(_measurement);
-        _error = obs-pCamera->project(v1->estimate().map(Xw));
+        _error = obs-ProjectPoint(pCamera,v1->estimate().map(Xw));
     }
 
     bool isDepthPositive() {
@@ -69,7 +70,7 @@ public:
     void computeError()  {
         const g2o::VertexSE3Expmap* v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[0]);
         Eigen::Vector2d obs(_measurement);
-        _error = obs-pCamera->project((mTrl * v1->estimate()).map(Xw));
+        _error = obs-ProjectPoint(pCamera,(mTrl * v1->estimate()).map(Xw));
     }
 
     bool isDepthPositive() {
@@ -100,7 +101,7 @@ public:
         const g2o::VertexSE3Expmap* v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[1]);
         const g2o::VertexSBAPointXYZ* v2 = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
         Eigen::Vector2d obs(_measurement);
-        _error = obs-pCamera->project(v1->estimate().map(v2->estimate()));
+        _error = obs-ProjectPoint(pCamera,v1->estimate().map(v2->estimate()));
     }
 
     bool isDepthPositive() {
@@ -128,7 +129,7 @@ public:
         const g2o::VertexSE3Expmap* v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[1]);
         const g2o::VertexSBAPointXYZ* v2 = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
         Eigen::Vector2d obs(_measurement);
-        _error = obs-pCamera->project((mTrl * v1->estimate()).map(v2->estimate()));
+        _error = obs-ProjectPoint(pCamera,(mTrl * v1->estimate()).map(v2->estimate()));
     }
 
     bool isDepthPositive() {
@@ -186,7 +187,7 @@ public:
         const g2o::VertexSBAPointXYZ* v2 = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
 
         Eigen::Vector2d obs(_measurement);
-        _error = obs-v1->pCamera1->project(v1->estimate().map(v2->estimate()));
+        _error = obs-ProjectPoint(v1->pCamera1,v1->estimate().map(v2->estimate()));
     }
 
     // virtual void linearizeOplus();
@@ -207,7 +208,7 @@ public:
         const g2o::VertexSBAPointXYZ* v2 = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
 
         Eigen::Vector2d obs(_measurement);
-        _error = obs-v1->pCamera2->project((v1->estimate().inverse().map(v2->estimate())));
+        _error = obs-ProjectPoint(v1->pCamera2,(v1->estimate().inverse().map(v2->estimate())));
     }
 
     // virtual void linearizeOplus();
@@ -0,0 +1,77 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+
+namespace ORB_SLAM3
+{
+
+// Block of N floats published with a sequence lock. Readers never block: they copy the block and
+// retry if a write overlapped the copy. Writers must be serialized by the caller (the owner mutex).
+template<int N>
+class SeqLock
+{
+public:
+    SeqLock(): mnSeq(0)
+    {
+        for(int i=0; i<N; i++)
+            mData[i].store(0.f,std::memory_order_relaxed);
+    }
+
+    void Write(const float* pSrc)
+    {
+        const unsigned int seq = mnSeq.load(std::memory_order_relaxed);
+        mnSeq.store(seq+1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(int i=0; i<N; i++)
+            mData[i].store(pSrc[i],std::memory_order_relaxed);
+        mnSeq.store(seq+2,std::memory_order_release);
+    }
+
+    // Copy n floats starting at nFirst
+    void Read(float* pDst, const int nFirst = 0, const int n = N) const
+    {
+        unsigned int seq0, seq1;
+        do
+        {
+            seq0 = mnSeq.load(std::memory_order_acquire);
+            for(int i=0; i<n; i++)
+                pDst[i] = mData[nFirst+i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq1 = mnSeq.load(std::memory_order_relaxed);
+        } while((seq0 & 1) || seq0!=seq1);
+    }
+
+    // Changes with every write. Data read after this call is at least as recent as the version returned
+    unsigned int Version() const
+    {
+        return mnSeq.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<unsigned int> mnSeq;
+    std::atomic<float> mData[N];
+};
+
+} //namespace ORB_SLAM
+
+#endif // SEQLOCK_H
@@ -86,6 +86,7 @@ namespace ORB_SLAM3 {
         bool needToUndistort() {return bNeedToUndistort_;}
 
         cv::Size newImSize() {return newImSize_;}
+        int undistortionLUT() {return undistortionLUT_;}
         float fps() {return fps_;}
         bool rgb() {return bRGB_;}
         bool needToResize() {return bNeedToResize1_;}
@@ -106,6 +107,8 @@ namespace ORB_SLAM3 {
         float initThFAST() {return initThFAST_;}
         float minThFAST() {return minThFAST_;}
         float scaleFactor() {return scaleFactor_;}
+        int nExtractorThreads() {return nExtractorThreads_;}
+        int distributionMethod() {return distributionMethod_;}
 
         float keyFrameSize() {return keyFrameSize_;}
         float keyFrameLineWidth() {return keyFrameLineWidth_;}
@@ -123,6 +126,8 @@ namespace ORB_SLAM3 {
         std::string atlasSaveFile() {return sSaveto_;}
 
         float thFarPoints() {return thFarPoints_;}
+        int nMappingThreads() {return nMappingThreads_;}
+        bool reclaimMemory() {return reclaimMemory_;}
 
         cv::Mat M1l() {return M1l_;}
         cv::Mat M2l() {return M2l_;}
@@ -174,6 +179,7 @@ namespace ORB_SLAM3 {
         std::vector<float> vPinHoleDistorsion1_, vPinHoleDistorsion2_;
 
         cv::Size originalImSize_, newImSize_;
+        int undistortionLUT_;
         float fps_;
         bool bRGB_;
 
@@ -212,6 +218,8 @@ namespace ORB_SLAM3 {
         float scaleFactor_;
         int nLevels_;
         int initThFAST_, minThFAST_;
+        int nExtractorThreads_;
+        int distributionMethod_;
 
         /*
          * Viewer stuff
@@ -234,6 +242,8 @@ namespace ORB_SLAM3 {
          * Other stuff
          */
         float thFarPoints_;
+        int nMappingThreads_;
+        bool reclaimMemory_;
 
     };
 };
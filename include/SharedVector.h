@@ -0,0 +1,61 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SHAREDVECTOR_H
+#define SHAREDVECTOR_H
+
+#include <vector>
+#include <memory>
+
+namespace ORB_SLAM3
+{
+
+// Reference counted vector that is read-only once built. Copies share the same storage, so
+// a Frame can be copied or promoted to a KeyFrame without copying its features.
+// Edit() gives write access, copying the elements first if the storage is shared.
+template<typename T>
+class SharedVector
+{
+public:
+    SharedVector(): mpData(std::make_shared<std::vector<T> >()) {}
+
+    SharedVector(std::vector<T> v): mpData(std::make_shared<std::vector<T> >(std::move(v))) {}
+
+    const T& operator[](const size_t i) const {return (*mpData)[i];}
+
+    size_t size() const {return mpData->size();}
+    bool empty() const {return mpData->empty();}
+
+    const std::vector<T>& get() const {return *mpData;}
+    operator const std::vector<T>&() const {return *mpData;}
+
+    std::vector<T>& Edit()
+    {
+        if(mpData.use_count()>1)
+            mpData = std::make_shared<std::vector<T> >(*mpData);
+        return *mpData;
+    }
+
+private:
+    std::shared_ptr<std::vector<T> > mpData;
+};
+
+} //namespace ORB_SLAM
+
+#endif // SHAREDVECTOR_H
@@ -0,0 +1,112 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+namespace ORB_SLAM3
+{
+
+// Set of object pointers stored densely in a vector. Insert and erase are O(1) (erase moves the last
+// element into the hole), iteration is a linear scan, and the dense slot of each element is tracked in
+// a hash table. Snapshot() shares one immutable copy of the elements until the next modification, so
+// repeated readers of an unchanged set do not copy it again. Not thread safe: the owner locks around it.
+template<class T>
+class SlotMap
+{
+public:
+    typedef typename std::vector<T*>::const_iterator const_iterator;
+
+    SlotMap(): mnVersion(0) {}
+
+    bool insert(T* p)
+    {
+        if(!mmSlots.insert(std::make_pair(p,mvpItems.size())).second)
+            return false;
+        mvpItems.push_back(p);
+        Modified();
+        return true;
+    }
+
+    bool erase(T* p)
+    {
+        typename std::unordered_map<T*,size_t>::iterator it = mmSlots.find(p);
+        if(it==mmSlots.end())
+            return false;
+
+        const size_t slot = it->second;
+        mmSlots.erase(it);
+        T* pLast = mvpItems.back();
+        mvpItems.pop_back();
+        if(pLast!=p)
+        {
+            mvpItems[slot] = pLast;
+            mmSlots[pLast] = slot;
+        }
+        Modified();
+        return true;
+    }
+
+    void clear()
+    {
+        mvpItems.clear();
+        mmSlots.clear();
+        Modified();
+    }
+
+    size_t count(T* p) const {return mmSlots.count(p);}
+    size_t size() const {return mvpItems.size();}
+    bool empty() const {return mvpItems.empty();}
+
+    const_iterator begin() const {return mvpItems.begin();}
+    const_iterator end() const {return mvpItems.end();}
+
+    const std::vector<T*>& items() const {return mvpItems;}
+
+    // Incremented on every modification
+    unsigned long version() const {return mnVersion;}
+
+    // Immutable copy of the elements, shared until the set changes
+    std::shared_ptr<const std::vector<T*> > Snapshot()
+    {
+        if(!mpSnapshot)
+            mpSnapshot = std::make_shared<const std::vector<T*> >(mvpItems);
+        return mpSnapshot;
+    }
+
+private:
+    void Modified()
+    {
+        mnVersion++;
+        mpSnapshot.reset();
+    }
+
+    std::vector<T*> mvpItems;
+    std::unordered_map<T*,size_t> mmSlots;
+    std::shared_ptr<const std::vector<T*> > mpSnapshot;
+    unsigned long mnVersion;
+};
+
+} //namespace ORB_SLAM
+
+#endif // SLOTMAP_H
@@ -39,6 +39,7 @@
 #include "Viewer.h"
 #include "ImuTypes.h"
 #include "Settings.h"
+#include "EpochManager.h"
 
 #include <Eigen/Dense> // 헤더 파일 포함
 
@@ -222,9 +223,18 @@ private:
     // performs relocalization if tracking fails.
     Tracking* mpTracker;
 
+    // Long-lived workers for the ORB extraction of every frame (stereo images and pyramid levels).
+    ThreadPool* mpExtractorPool;
+
     // Local Mapper. It manages the local map and performs local bundle adjustment.
     LocalMapping* mpLocalMapper;
 
+    // Workers that share the neighbor keyframes of the triangulation with the local mapper.
+    ThreadPool* mpMappingPool;
+
+    // Deferred release of culled keyframes and map points. NULL unless System.ReclaimMemory is set.
+    EpochManager* mpEpochManager;
+
     // Loop Closer. It searches loops with every new keyframe. If there is a loop it performs
     // a pose graph optimization and full bundle adjustment (in a new thread) afterwards.
     LoopClosing* mpLoopCloser;
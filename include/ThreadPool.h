@@ -0,0 +1,67 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+namespace ORB_SLAM3
+{
+
+// Set of long-lived worker threads shared by the modules that split their work per frame.
+class ThreadPool
+{
+public:
+    // Create nThreads workers. The thread calling ParallelFor also takes part in the work,
+    // so a pool without workers runs everything in the caller.
+    ThreadPool(const int nThreads);
+
+    ~ThreadPool();
+
+    int GetNumThreads() const;
+
+    // Run f(i) for every i in [0,n) and return when all of them are finished.
+    // It can be called from a job running in this same pool.
+    void ParallelFor(const int n, const std::function<void(int)> &f);
+
+    // Run f in a worker (in the caller if there are no workers).
+    // If pTime is given, the time spent running f (ms) is written there before the future is ready.
+    // Do not wait for the result from inside a job of this same pool.
+    std::future<void> Submit(const std::function<void()> &f, double* pTime = NULL);
+
+private:
+    void Run();
+
+    std::vector<std::thread> mvThreads;
+
+    std::deque<std::function<void()> > mlJobs;
+    std::mutex mMutexJobs;
+    std::condition_variable mcvJobs;
+    bool mbStop;
+};
+
+} //namespace ORB_SLAM
+
+#endif // THREADPOOL_H
@@ -36,6 +36,10 @@
 #include "System.h"
 #include "ImuTypes.h"
 #include "Settings.h"
+#include "ThreadPool.h"
+#include "UndistortionLUT.h"
+#include "MapPointSnapshot.h"
+#include "EpochManager.h"
 
 #include "GeometricCamera.h"
 
@@ -89,6 +93,11 @@ public:
     void SetLocalMapper(LocalMapping* pLocalMapper);
     void SetLoopClosing(LoopClosing* pLoopClosing);
     void SetViewer(Viewer* pViewer);
+    // Workers used by the frames to extract ORB (owned by the System)
+    void SetExtractorPool(ThreadPool* pPool);
+    // Deferred release of culled keyframes and points (owned by the System, NULL if disabled)
+    void SetEpochManager(EpochManager* pEpochManager);
+    int GetExtractorThreads();
     void SetStepByStep(bool bSet);
     bool GetStepByStep();
 
@@ -195,6 +204,8 @@ public:
     vector<double> vdRectStereo_ms;
     vector<double> vdResizeImage_ms;
     vector<double> vdORBExtract_ms;
+    vector<double> vdORBExtractLeft_ms;
+    vector<double> vdORBExtractRight_ms;
     vector<double> vdStereoMatch_ms;
     vector<double> vdIMUInteg_ms;
     vector<double> vdPosePred_ms;
@@ -284,6 +295,19 @@ protected:
     KeyFrame* mpReferenceKF;
     std::vector<KeyFrame*> mvpLocalKeyFrames;
     std::vector<MapPoint*> mvpLocalMapPoints;
+
+    // Scratch of UpdateLocalKeyFrames, reused every frame. Votes of the keyframes indexed by mnId,
+    // valid where the stamp is the one of the current call, and the keyframes voted in order
+    std::vector<int> mvKeyFrameVotes;
+    std::vector<unsigned long> mvKeyFrameVoteStamps;
+    unsigned long mnKeyFrameVoteStamp;
+    std::vector<KeyFrame*> mvpVotedKeyFrames;
+    std::vector<KeyFrame*> mvpNeighborKeyFrames;
+
+    // Geometry of the local map points for the frustum checks (copied in UpdateLocalPoints)
+    // and the points in view of the current frame
+    MapPointSnapshot mLocalPointsSnapshot;
+    std::vector<MapPoint*> mvpLocalPointsInView;
     
     // System
     System* mpSystem;
@@ -368,6 +392,22 @@ protected:
 
     void newParameterLoader(Settings* settings);
 
+    // Number of threads for the ORB extraction of each image (ORBextractor.nThreads)
+    int mnExtractorThreads;
+
+    // Workers that share the local map search with the tracking thread (NULL to search serially)
+    ThreadPool* mpLocalMapPool;
+
+    // Drop the bad points kept from the previous frame and report a quiescent state
+    void PurgeBadMapPoints();
+    EpochManager* mpEpochManager;
+    int mnEpochId;
+
+    // Precomputed keypoint undistortion of the pinhole camera (Camera.undistortionLUT), NULL if disabled
+    void BuildUndistortionLUT(const cv::Size &imSize, const int nSubdivisions);
+    UndistortionLUT* mpUndistortionLUT;
+    cv::Size mLUTImSize;
+
 #ifdef REGISTER_LOOP
     bool Stop();
 
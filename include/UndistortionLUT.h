@@ -0,0 +1,59 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UNDISTORTIONLUT_H
+#define UNDISTORTIONLUT_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3
+{
+
+// Undistorted coordinates of a pinhole camera with radial-tangential distortion, precomputed on a
+// grid of nodes over the image and interpolated bilinearly. Each pixel is split into nSubdivisions
+// cells per axis.
+class UndistortionLUT
+{
+public:
+    UndistortionLUT(const cv::Mat &K, const cv::Mat &distCoef, const cv::Size &imSize, const int nSubdivisions);
+
+    // Same result as cv::undistortPoints(...,K,distCoef,cv::Mat(),K) up to the interpolation error.
+    // Keypoints out of the image are undistorted exactly.
+    void Undistort(const std::vector<cv::KeyPoint> &vKeys, std::vector<cv::KeyPoint> &vKeysUn) const;
+
+    int GetSubdivisions() const {return mnSubdivisions;}
+
+private:
+    void Interpolate(const float* pX, const float* pY, const int n, float* pXUn, float* pYUn) const;
+
+    cv::Mat mK, mDistCoef;
+
+    int mnSubdivisions;
+    float mfMaxX, mfMaxY;
+
+    // Node (ix,iy) is at pixel (ix,iy)/nSubdivisions, stored at iy*mnStride+ix
+    int mnStride;
+    std::vector<float> mvMapX, mvMapY;
+};
+
+} //namespace ORB_SLAM
+
+#endif // UNDISTORTIONLUT_H
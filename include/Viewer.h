@@ -25,6 +25,7 @@
 #include "Tracking.h"
 #include "System.h"
 #include "Settings.h"
+#include "EpochManager.h"
 
 #include <mutex>
 
@@ -61,6 +62,9 @@ public:
 
     void Release();
 
+    // Deferred release of culled keyframes and points (owned by the System, NULL if disabled)
+    void SetEpochManager(EpochManager* pEpochManager);
+
     //void SetTrackingPause();
 
     bool both;
@@ -94,6 +98,9 @@ private:
 
     bool mbStopTrack;
 
+    EpochManager* mpEpochManager;
+    int mnEpochId;
+
 };
 
 }
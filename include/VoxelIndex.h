@@ -0,0 +1,297 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VOXELINDEX_H
+#define VOXELINDEX_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Core>
+
+namespace ORB_SLAM3
+{
+
+// Spatial hash of object pointers by position. Space is split in cubic voxels and only the occupied
+// ones are stored, so memory follows the number of objects and not the extent of the map. Insert,
+// move and erase are O(1); box and radius queries visit the voxels overlapping the region (or every
+// occupied voxel if there are fewer of them) and nearest neighbor queries grow a shell of voxels
+// around the query until no closer object can be found. Not thread safe: the owner locks around it.
+template<class T>
+class VoxelIndex
+{
+public:
+    explicit VoxelIndex(const float voxelSize): mfVoxelSize(voxelSize), mfInvVoxelSize(1.f/voxelSize) {}
+
+    // Insert the object or move it if it is already indexed
+    void insert(T* p, const Eigen::Vector3f &pos)
+    {
+        typename std::unordered_map<T*,uint64_t>::iterator it = mmKeys.find(p);
+        if(it==mmKeys.end())
+        {
+            const uint64_t key = Key(pos);
+            mmKeys[p] = key;
+            mmVoxels[key].push_back(Entry(p,pos));
+        }
+        else
+            Move(it,pos);
+    }
+
+    // Move the object if it is indexed
+    void update(T* p, const Eigen::Vector3f &pos)
+    {
+        typename std::unordered_map<T*,uint64_t>::iterator it = mmKeys.find(p);
+        if(it!=mmKeys.end())
+            Move(it,pos);
+    }
+
+    bool erase(T* p)
+    {
+        typename std::unordered_map<T*,uint64_t>::iterator it = mmKeys.find(p);
+        if(it==mmKeys.end())
+            return false;
+        EraseFromVoxel(it->second,p);
+        mmKeys.erase(it);
+        return true;
+    }
+
+    void clear()
+    {
+        mmVoxels.clear();
+        mmKeys.clear();
+    }
+
+    size_t count(T* p) const {return mmKeys.count(p);}
+    size_t size() const {return mmKeys.size();}
+    bool empty() const {return mmKeys.empty();}
+    float voxelSize() const {return mfVoxelSize;}
+
+    // Call f(p,pos) for every object inside the axis aligned box [minPos,maxPos]
+    template<class F>
+    void ForEachInBox(const Eigen::Vector3f &minPos, const Eigen::Vector3f &maxPos, F f) const
+    {
+        int lo[3], hi[3];
+        Cell(minPos,lo);
+        Cell(maxPos,hi);
+
+        const double nCells = double(hi[0]-lo[0]+1)*double(hi[1]-lo[1]+1)*double(hi[2]-lo[2]+1);
+        if(nCells>double(mmVoxels.size()))
+        {
+            // Fewer occupied voxels than voxels in the box
+            for(typename VoxelMap::const_iterator vit=mmVoxels.begin(), vend=mmVoxels.end(); vit!=vend; vit++)
+                VisitInBox(vit->second,minPos,maxPos,f);
+            return;
+        }
+
+        for(int x=lo[0]; x<=hi[0]; x++)
+            for(int y=lo[1]; y<=hi[1]; y++)
+                for(int z=lo[2]; z<=hi[2]; z++)
+                {
+                    typename VoxelMap::const_iterator vit = mmVoxels.find(Key(x,y,z));
+                    if(vit!=mmVoxels.end())
+                        VisitInBox(vit->second,minPos,maxPos,f);
+                }
+    }
+
+    // Objects closer than r to center
+    std::vector<T*> QueryRadius(const Eigen::Vector3f &center, const float r) const
+    {
+        std::vector<T*> vp;
+        const float r2 = r*r;
+        ForEachInBox(center-Eigen::Vector3f::Constant(r),center+Eigen::Vector3f::Constant(r),
+                     [&](T* p, const Eigen::Vector3f &pos)
+        {
+            if((pos-center).squaredNorm()<=r2)
+                vp.push_back(p);
+        });
+        return vp;
+    }
+
+    // The k objects nearest to pos, sorted by increasing distance
+    std::vector<T*> QueryNearest(const Eigen::Vector3f &pos, const size_t k) const
+    {
+        // Max-heap of the squared distances of the k nearest objects found so far
+        std::vector<std::pair<float,T*> > vHeap;
+        if(k==0 || mmKeys.empty())
+            return std::vector<T*>();
+        vHeap.reserve(k+1);
+
+        int c[3];
+        Cell(pos,c);
+        size_t nVisited = 0;
+        for(int R=0; ; R++)
+        {
+            const double nShell = R==0 ? 1.0 : std::pow(2.0*R+1,3)-std::pow(2.0*R-1,3);
+            if(nShell>double(mmVoxels.size()))
+            {
+                // The shell is larger than the occupied voxels: finish with a scan of all of them
+                vHeap.clear();
+                for(typename VoxelMap::const_iterator vit=mmVoxels.begin(), vend=mmVoxels.end(); vit!=vend; vit++)
+                    PushNearest(vit->second,pos,k,vHeap);
+                break;
+            }
+
+            for(int dx=-R; dx<=R; dx++)
+                for(int dy=-R; dy<=R; dy++)
+                {
+                    // Only the faces of the shell: every z on the side faces, the two ends elsewhere
+                    const bool bSide = std::abs(dx)==R || std::abs(dy)==R;
+                    const int step = bSide ? 1 : std::max(2*R,1);
+                    for(int dz=-R; dz<=R; dz+=step)
+                    {
+                        typename VoxelMap::const_iterator vit = mmVoxels.find(Key(c[0]+dx,c[1]+dy,c[2]+dz));
+                        if(vit==mmVoxels.end())
+                            continue;
+                        nVisited += vit->second.size();
+                        PushNearest(vit->second,pos,k,vHeap);
+                    }
+                }
+
+            // Objects not visited yet are at least R voxels away
+            if(nVisited==mmKeys.size())
+                break;
+            const float minDist = R*mfVoxelSize;
+            if(vHeap.size()==k && vHeap.front().first<=minDist*minDist)
+                break;
+        }
+
+        std::sort_heap(vHeap.begin(),vHeap.end());
+        std::vector<T*> vp;
+        vp.reserve(vHeap.size());
+        for(size_t i=0; i<vHeap.size(); i++)
+            vp.push_back(vHeap[i].second);
+        return vp;
+    }
+
+private:
+    struct Entry
+    {
+        Entry(T* p_, const Eigen::Vector3f &pos_): p(p_), pos(pos_) {}
+        T* p;
+        Eigen::Vector3f pos;
+    };
+    typedef std::unordered_map<uint64_t,std::vector<Entry> > VoxelMap;
+
+    void Cell(const Eigen::Vector3f &pos, int* c) const
+    {
+        // Clamped to the 21 bits per axis of the key (NaN goes to voxel 0)
+        for(int i=0; i<3; i++)
+        {
+            const float v = std::floor(pos[i]*mfInvVoxelSize);
+            c[i] = v>=-1048576.f && v<=1048575.f ? int(v) : (v>0.f ? 1048575 : (v<0.f ? -1048576 : 0));
+        }
+    }
+
+    static uint64_t Key(const int x, const int y, const int z)
+    {
+        return (uint64_t(x & 0x1FFFFF) << 42) | (uint64_t(y & 0x1FFFFF) << 21) | uint64_t(z & 0x1FFFFF);
+    }
+
+    uint64_t Key(const Eigen::Vector3f &pos) const
+    {
+        int c[3];
+        Cell(pos,c);
+        return Key(c[0],c[1],c[2]);
+    }
+
+    void Move(typename std::unordered_map<T*,uint64_t>::iterator it, const Eigen::Vector3f &pos)
+    {
+        const uint64_t key = Key(pos);
+        if(key==it->second)
+        {
+            std::vector<Entry> &vEntries = mmVoxels[key];
+            for(size_t i=0; i<vEntries.size(); i++)
+            {
+                if(vEntries[i].p==it->first)
+                {
+                    vEntries[i].pos = pos;
+                    break;
+                }
+            }
+            return;
+        }
+
+        EraseFromVoxel(it->second,it->first);
+        it->second = key;
+        mmVoxels[key].push_back(Entry(it->first,pos));
+    }
+
+    void EraseFromVoxel(const uint64_t key, T* p)
+    {
+        typename VoxelMap::iterator vit = mmVoxels.find(key);
+        if(vit==mmVoxels.end())
+            return;
+        std::vector<Entry> &vEntries = vit->second;
+        for(size_t i=0; i<vEntries.size(); i++)
+        {
+            if(vEntries[i].p==p)
+            {
+                vEntries[i] = vEntries.back();
+                vEntries.pop_back();
+                break;
+            }
+        }
+        if(vEntries.empty())
+            mmVoxels.erase(vit);
+    }
+
+    template<class F>
+    static void VisitInBox(const std::vector<Entry> &vEntries, const Eigen::Vector3f &minPos, const Eigen::Vector3f &maxPos, F &f)
+    {
+        for(size_t i=0; i<vEntries.size(); i++)
+        {
+            const Eigen::Vector3f &pos = vEntries[i].pos;
+            if((pos.array()>=minPos.array()).all() && (pos.array()<=maxPos.array()).all())
+                f(vEntries[i].p,pos);
+        }
+    }
+
+    static void PushNearest(const std::vector<Entry> &vEntries, const Eigen::Vector3f &pos, const size_t k,
+                            std::vector<std::pair<float,T*> > &vHeap)
+    {
+        for(size_t i=0; i<vEntries.size(); i++)
+        {
+            const float d2 = (vEntries[i].pos-pos).squaredNorm();
+            if(!(d2==d2))
+                continue;
+            if(vHeap.size()<k)
+            {
+                vHeap.push_back(std::make_pair(d2,vEntries[i].p));
+                std::push_heap(vHeap.begin(),vHeap.end());
+            }
+            else if(d2<vHeap.front().first)
+            {
+                std::pop_heap(vHeap.begin(),vHeap.end());
+                vHeap.back() = std::make_pair(d2,vEntries[i].p);
+                std::push_heap(vHeap.begin(),vHeap.end());
+            }
+        }
+    }
+
+    float mfVoxelSize;
+    float mfInvVoxelSize;
+    VoxelMap mmVoxels;
+    std::unordered_map<T*,uint64_t> mmKeys;
+};
+
+} //namespace ORB_SLAM
+
+#endif // VOXELINDEX_H
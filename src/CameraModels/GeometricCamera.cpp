@@ -0,0 +1,54 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "GeometricCamera.h"
+#include "CameraModel.h"
+#include "KannalaBrandt8.h"
+
+namespace ORB_SLAM3 {
+
+    template<unsigned int Type>
+    static void ProjectLoop(const float* k, const float* pX, const float* pY, const float* pZ, const size_t n, float* pU, float* pV) {
+        for(size_t i = 0; i < n; i++)
+            CameraModel<Type>::project(k, pX[i], pY[i], pZ[i], pU[i], pV[i]);
+    }
+
+    template<unsigned int Type>
+    static void UnprojectLoop(const float* k, const float precision, const cv::KeyPoint* pKeys, const size_t n, Eigen::Vector3f* pRays) {
+        for(size_t i = 0; i < n; i++){
+            float x, y;
+            CameraModel<Type>::unproject(k, precision, pKeys[i].pt.x, pKeys[i].pt.y, x, y);
+            pRays[i] = Eigen::Vector3f(x, y, 1.f);
+        }
+    }
+
+    void GeometricCamera::projectBatch(const float* pX, const float* pY, const float* pZ, const size_t n, float* pU, float* pV) {
+        if(mnType == CAM_PINHOLE)
+            ProjectLoop<CAM_PINHOLE>(mvParameters.data(), pX, pY, pZ, n, pU, pV);
+        else
+            ProjectLoop<CAM_FISHEYE>(mvParameters.data(), pX, pY, pZ, n, pU, pV);
+    }
+
+    void GeometricCamera::unprojectBatch(const cv::KeyPoint* pKeys, const size_t n, Eigen::Vector3f* pRays) {
+        if(mnType == CAM_PINHOLE)
+            UnprojectLoop<CAM_PINHOLE>(mvParameters.data(), 0.f, pKeys, n, pRays);
+        else
+            static_cast<KannalaBrandt8*>(this)->UnprojectWithLUT(pKeys, n, pRays);
+    }
+}
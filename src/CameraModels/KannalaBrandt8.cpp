@@ -17,9 +17,15 @@
 */
 
 #include "KannalaBrandt8.h"
+#include "CameraModel.h"
 
 #include <boost/serialization/export.hpp>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KANNALABRANDT8_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 //BOOST_CLASS_EXPORT_IMPLEMENT(ORB_SLAM3::KannalaBrandt8)
 
 namespace ORB_SLAM3 {
@@ -44,52 +50,17 @@ namespace ORB_SLAM3 {
     }
 
     Eigen::Vector2d KannalaBrandt8::project(const Eigen::Vector3d &v3D) {
-        const double x2_plus_y2 = v3D[0] * v3D[0] + v3D[1] * v3D[1];
-        const double theta = atan2f(sqrtf(x2_plus_y2), v3D[2]);
-        const double psi = atan2f(v3D[1], v3D[0]);
-
-        const double theta2 = theta * theta;
-        const double theta3 = theta * theta2;
-        const double theta5 = theta3 * theta2;
-        const double theta7 = theta5 * theta2;
-        const double theta9 = theta7 * theta2;
-        const double r = theta + mvParameters[4] * theta3 + mvParameters[5] * theta5
-                        + mvParameters[6] * theta7 + mvParameters[7] * theta9;
-
         Eigen::Vector2d res;
-        res[0] = mvParameters[0] * r * cos(psi) + mvParameters[2];
-        res[1] = mvParameters[1] * r * sin(psi) + mvParameters[3];
+        CameraModel<CAM_FISHEYE>::project(mvParameters.data(), v3D[0], v3D[1], v3D[2], res[0], res[1]);
 
         return res;
-
     }
 
     Eigen::Vector2f KannalaBrandt8::project(const Eigen::Vector3f &v3D) {
-        const float x2_plus_y2 = v3D[0] * v3D[0] + v3D[1] * v3D[1];
-        const float theta = atan2f(sqrtf(x2_plus_y2), v3D[2]);
-        const float psi = atan2f(v3D[1], v3D[0]);
-
-        const float theta2 = theta * theta;
-        const float theta3 = theta * theta2;
-        const float theta5 = theta3 * theta2;
-        const float theta7 = theta5 * theta2;
-        const float theta9 = theta7 * theta2;
-        const float r = theta + mvParameters[4] * theta3 + mvParameters[5] * theta5
-                         + mvParameters[6] * theta7 + mvParameters[7] * theta9;
-
         Eigen::Vector2f res;
-        res[0] = mvParameters[0] * r * cos(psi) + mvParameters[2];
-        res[1] = mvParameters[1] * r * sin(psi) + mvParameters[3];
+        CameraModel<CAM_FISHEYE>::project(mvParameters.data(), v3D[0], v3D[1], v3D[2], res[0], res[1]);
 
         return res;
-
-        /*cv::Point2f cvres = this->project(cv::Point3f(v3D[0],v3D[1],v3D[2]));
-
-        Eigen::Vector2d res;
-        res[0] = cvres.x;
-        res[1] = cvres.y;
-
-        return res;*/
     }
 
     Eigen::Vector2f KannalaBrandt8::projectMat(const cv::Point3f &p3D) {
@@ -114,64 +85,122 @@ namespace ORB_SLAM3 {
     }
 
     cv::Point3f KannalaBrandt8::unproject(const cv::Point2f &p2D) {
-        //Use Newthon method to solve for theta with good precision (err ~ e-6)
-        cv::Point2f pw((p2D.x - mvParameters[2]) / mvParameters[0], (p2D.y - mvParameters[3]) / mvParameters[1]);
+        if(mvThetaLUT.empty()){
+            float x, y;
+            CameraModel<CAM_FISHEYE>::unproject(mvParameters.data(), precision, p2D.x, p2D.y, x, y);
+            return cv::Point3f(x, y, 1.f);
+        }
+
+        const float pwx = (p2D.x - mvParameters[2]) / mvParameters[0];
+        const float pwy = (p2D.y - mvParameters[3]) / mvParameters[1];
+        const float theta_d = CameraModel<CAM_FISHEYE>::thetaDistorted(pwx, pwy);
         float scale = 1.f;
-        float theta_d = sqrtf(pw.x * pw.x + pw.y * pw.y);
-        theta_d = fminf(fmaxf(-CV_PI / 2.f, theta_d), CV_PI / 2.f);
-
-        if (theta_d > 1e-8) {
-            //Compensate distortion iteratively
-            float theta = theta_d;
-
-            for (int j = 0; j < 10; j++) {
-                float theta2 = theta * theta, theta4 = theta2 * theta2, theta6 = theta4 * theta2, theta8 =
-                        theta4 * theta4;
-                float k0_theta2 = mvParameters[4] * theta2, k1_theta4 = mvParameters[5] * theta4;
-                float k2_theta6 = mvParameters[6] * theta6, k3_theta8 = mvParameters[7] * theta8;
-                float theta_fix = (theta * (1 + k0_theta2 + k1_theta4 + k2_theta6 + k3_theta8) - theta_d) /
-                                  (1 + 3 * k0_theta2 + 5 * k1_theta4 + 7 * k2_theta6 + 9 * k3_theta8);
-                theta = theta - theta_fix;
-                if (fabsf(theta_fix) < precision)
-                    break;
-            }
-            //scale = theta - theta_d;
-            scale = std::tan(theta) / theta_d;
+        if (theta_d > 1e-8)
+            scale = std::tan(ThetaFromLUT(theta_d)) / theta_d;
+
+        return cv::Point3f(pwx * scale, pwy * scale, 1.f);
+    }
+
+    void KannalaBrandt8::BuildUnprojectLUT() {
+        const float step = (CV_PI / 2.f) / UNPROJECT_LUT_SIZE;
+        mfLUTInvStep = 1.f / step;
+        mvThetaLUT.resize(UNPROJECT_LUT_SIZE + 1);
+        for(int i = 0; i <= UNPROJECT_LUT_SIZE; i++)
+            mvThetaLUT[i] = CameraModel<CAM_FISHEYE>::solveTheta(mvParameters.data(), precision, i * step);
+    }
+
+    float KannalaBrandt8::ThetaFromLUT(const float theta_d) {
+        const float s = theta_d * mfLUTInvStep;
+        const int i = std::min(static_cast<int>(s), UNPROJECT_LUT_SIZE - 1);
+        const float a = s - i;
+        const float theta = mvThetaLUT[i] + a * (mvThetaLUT[i+1] - mvThetaLUT[i]);
+        return theta - CameraModel<CAM_FISHEYE>::thetaNewtonFix(mvParameters.data(), theta, theta_d);
+    }
+
+#ifdef KANNALABRANDT8_X86_DISPATCH
+
+    // ThetaFromLUT for eight radii per iteration. Returns the number of radii processed.
+    __attribute__((target("avx2")))
+    static size_t ThetaFromLUTAVX2(const float* k, const float* pLUT, const float invStep, const int nLast,
+                                   const float* pThetaD, const size_t n, float* pTheta) {
+        const __m256 vInvStep = _mm256_set1_ps(invStep);
+        const __m256i vLast = _mm256_set1_epi32(nLast - 1);
+        const __m256i vOne = _mm256_set1_epi32(1);
+        const __m256 one = _mm256_set1_ps(1.f);
+        const __m256 k0 = _mm256_set1_ps(k[4]), k1 = _mm256_set1_ps(k[5]);
+        const __m256 k2 = _mm256_set1_ps(k[6]), k3 = _mm256_set1_ps(k[7]);
+        const __m256 c3 = _mm256_set1_ps(3.f), c5 = _mm256_set1_ps(5.f);
+        const __m256 c7 = _mm256_set1_ps(7.f), c9 = _mm256_set1_ps(9.f);
+
+        size_t i = 0;
+        for(; i + 8 <= n; i += 8){
+            const __m256 theta_d = _mm256_loadu_ps(pThetaD + i);
+            const __m256 s = _mm256_mul_ps(theta_d, vInvStep);
+            const __m256i idx = _mm256_min_epi32(_mm256_cvttps_epi32(s), vLast);
+            const __m256 a = _mm256_sub_ps(s, _mm256_cvtepi32_ps(idx));
+            const __m256 l0 = _mm256_i32gather_ps(pLUT, idx, 4);
+            const __m256 l1 = _mm256_i32gather_ps(pLUT, _mm256_add_epi32(idx, vOne), 4);
+            const __m256 theta = _mm256_add_ps(l0, _mm256_mul_ps(a, _mm256_sub_ps(l1, l0)));
+
+            const __m256 theta2 = _mm256_mul_ps(theta, theta);
+            const __m256 theta4 = _mm256_mul_ps(theta2, theta2);
+            const __m256 theta6 = _mm256_mul_ps(theta4, theta2);
+            const __m256 theta8 = _mm256_mul_ps(theta4, theta4);
+            const __m256 k0_theta2 = _mm256_mul_ps(k0, theta2);
+            const __m256 k1_theta4 = _mm256_mul_ps(k1, theta4);
+            const __m256 k2_theta6 = _mm256_mul_ps(k2, theta6);
+            const __m256 k3_theta8 = _mm256_mul_ps(k3, theta8);
+
+            __m256 num = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(one, k0_theta2), k1_theta4), k2_theta6), k3_theta8);
+            num = _mm256_sub_ps(_mm256_mul_ps(theta, num), theta_d);
+            __m256 den = _mm256_add_ps(one, _mm256_mul_ps(c3, k0_theta2));
+            den = _mm256_add_ps(den, _mm256_mul_ps(c5, k1_theta4));
+            den = _mm256_add_ps(den, _mm256_mul_ps(c7, k2_theta6));
+            den = _mm256_add_ps(den, _mm256_mul_ps(c9, k3_theta8));
+
+            _mm256_storeu_ps(pTheta + i, _mm256_sub_ps(theta, _mm256_div_ps(num, den)));
+        }
+        return i;
+    }
+
+#endif
+
+    void KannalaBrandt8::UnprojectWithLUT(const cv::KeyPoint* pKeys, const size_t n, Eigen::Vector3f* pRays) {
+        if(mvThetaLUT.empty()){
+            for(size_t i = 0; i < n; i++)
+                pRays[i] = unprojectEig(pKeys[i].pt);
+            return;
         }
 
-        return cv::Point3f(pw.x * scale, pw.y * scale, 1.f);
+        std::vector<float> vPwx(n), vPwy(n), vThetaD(n), vTheta(n);
+        for(size_t i = 0; i < n; i++){
+            vPwx[i] = (pKeys[i].pt.x - mvParameters[2]) / mvParameters[0];
+            vPwy[i] = (pKeys[i].pt.y - mvParameters[3]) / mvParameters[1];
+            vThetaD[i] = CameraModel<CAM_FISHEYE>::thetaDistorted(vPwx[i], vPwy[i]);
+        }
+
+        size_t i = 0;
+#ifdef KANNALABRANDT8_X86_DISPATCH
+        static const bool bAVX2 = __builtin_cpu_supports("avx2");
+        if(bAVX2)
+            i = ThetaFromLUTAVX2(mvParameters.data(), mvThetaLUT.data(), mfLUTInvStep, UNPROJECT_LUT_SIZE, vThetaD.data(), n, vTheta.data());
+#endif
+        for(; i < n; i++)
+            vTheta[i] = ThetaFromLUT(vThetaD[i]);
+
+        for(i = 0; i < n; i++){
+            float scale = 1.f;
+            if (vThetaD[i] > 1e-8)
+                scale = std::tan(vTheta[i]) / vThetaD[i];
+            pRays[i] = Eigen::Vector3f(vPwx[i] * scale, vPwy[i] * scale, 1.f);
+        }
     }
 
     Eigen::Matrix<double, 2, 3> KannalaBrandt8::projectJac(const Eigen::Vector3d &v3D) {
-        double x2 = v3D[0] * v3D[0], y2 = v3D[1] * v3D[1], z2 = v3D[2] * v3D[2];
-        double r2 = x2 + y2;
-        double r = sqrt(r2);
-        double r3 = r2 * r;
-        double theta = atan2(r, v3D[2]);
-
-        double theta2 = theta * theta, theta3 = theta2 * theta;
-        double theta4 = theta2 * theta2, theta5 = theta4 * theta;
-        double theta6 = theta2 * theta4, theta7 = theta6 * theta;
-        double theta8 = theta4 * theta4, theta9 = theta8 * theta;
-
-        double f = theta + theta3 * mvParameters[4] + theta5 * mvParameters[5] + theta7 * mvParameters[6] +
-                  theta9 * mvParameters[7];
-        double fd = 1 + 3 * mvParameters[4] * theta2 + 5 * mvParameters[5] * theta4 + 7 * mvParameters[6] * theta6 +
-                   9 * mvParameters[7] * theta8;
-
-        Eigen::Matrix<double, 2, 3> JacGood;
-        JacGood(0, 0) = mvParameters[0] * (fd * v3D[2] * x2 / (r2 * (r2 + z2)) + f * y2 / r3);
-        JacGood(1, 0) =
-                mvParameters[1] * (fd * v3D[2] * v3D[1] * v3D[0] / (r2 * (r2 + z2)) - f * v3D[1] * v3D[0] / r3);
-
-        JacGood(0, 1) =
-                mvParameters[0] * (fd * v3D[2] * v3D[1] * v3D[0] / (r2 * (r2 + z2)) - f * v3D[1] * v3D[0] / r3);
-        JacGood(1, 1) = mvParameters[1] * (fd * v3D[2] * y2 / (r2 * (r2 + z2)) + f * x2 / r3);
-
-        JacGood(0, 2) = -mvParameters[0] * fd * v3D[0] / (r2 + z2);
-        JacGood(1, 2) = -mvParameters[1] * fd * v3D[1] / (r2 + z2);
-
-        return JacGood;
+        Eigen::Matrix<double, 2, 3> Jac;
+        CameraModel<CAM_FISHEYE>::projectJac(mvParameters.data(), v3D[0], v3D[1], v3D[2], Jac);
+
+        return Jac;
     }
 
     bool KannalaBrandt8::ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
@@ -388,6 +417,7 @@ namespace ORB_SLAM3 {
             kb.mvParameters[i] = nextParam;
 
         }
+        kb.BuildUnprojectLUT();
         return is;
     }
 
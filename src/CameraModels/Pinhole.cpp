@@ -17,6 +17,7 @@
 */
 
 #include "Pinhole.h"
+#include "CameraModel.h"
 
 #include <boost/serialization/export.hpp>
 
@@ -34,16 +35,14 @@ namespace ORB_SLAM3 {
 
     Eigen::Vector2d Pinhole::project(const Eigen::Vector3d &v3D) {
         Eigen::Vector2d res;
-        res[0] = mvParameters[0] * v3D[0] / v3D[2] + mvParameters[2];
-        res[1] = mvParameters[1] * v3D[1] / v3D[2] + mvParameters[3];
+        CameraModel<CAM_PINHOLE>::project(mvParameters.data(), v3D[0], v3D[1], v3D[2], res[0], res[1]);
 
         return res;
     }
 
     Eigen::Vector2f Pinhole::project(const Eigen::Vector3f &v3D) {
         Eigen::Vector2f res;
-        res[0] = mvParameters[0] * v3D[0] / v3D[2] + mvParameters[2];
-        res[1] = mvParameters[1] * v3D[1] / v3D[2] + mvParameters[3];
+        CameraModel<CAM_PINHOLE>::project(mvParameters.data(), v3D[0], v3D[1], v3D[2], res[0], res[1]);
 
         return res;
     }
@@ -70,12 +69,7 @@ namespace ORB_SLAM3 {
 
     Eigen::Matrix<double, 2, 3> Pinhole::projectJac(const Eigen::Vector3d &v3D) {
         Eigen::Matrix<double, 2, 3> Jac;
-        Jac(0, 0) = mvParameters[0] / v3D[2];
-        Jac(0, 1) = 0.f;
-        Jac(0, 2) = -mvParameters[0] * v3D[0] / (v3D[2] * v3D[2]);
-        Jac(1, 0) = 0.f;
-        Jac(1, 1) = mvParameters[1] / v3D[2];
-        Jac(1, 2) = -mvParameters[1] * v3D[1] / (v3D[2] * v3D[2]);
+        CameraModel<CAM_PINHOLE>::projectJac(mvParameters.data(), v3D[0], v3D[1], v3D[2], Jac);
 
         return Jac;
     }
@@ -0,0 +1,238 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "EpochManager.h"
+#include "Atlas.h"
+#include "Map.h"
+#include "MapPoint.h"
+#include "KeyFrame.h"
+
+#include <unordered_set>
+#include <iostream>
+
+namespace ORB_SLAM3
+{
+
+// Epochs to wait after a retire (and again after unlinking) before the next step. A participant may
+// take a pointer just before a retire and report once while still holding it: three epochs make sure it
+// has reported again after dropping the bad pointers it keeps between iterations
+static const unsigned long GRACE_EPOCHS = 3;
+
+EpochManager::EpochManager(): mnGlobalEpoch(0), mnReclaimedBytes(0)
+{
+    for(int i=0; i<MAX_PARTICIPANTS; i++)
+    {
+        mvnLocalEpoch[i].store(0);
+        mvbActive[i].store(false);
+    }
+}
+
+int EpochManager::Register()
+{
+    std::unique_lock<std::mutex> lock(mMutexRetired);
+    for(int i=0; i<MAX_PARTICIPANTS; i++)
+    {
+        if(!mvbActive[i].load())
+        {
+            mvnLocalEpoch[i].store(mnGlobalEpoch.load());
+            mvbActive[i].store(true);
+            return i;
+        }
+    }
+
+    std::cerr << "ERROR: too many participants in the epoch manager" << std::endl;
+    return -1;
+}
+
+void EpochManager::Unregister(const int nId)
+{
+    if(nId<0)
+        return;
+    mvbActive[nId].store(false);
+}
+
+void EpochManager::Quiescent(const int nId)
+{
+    if(nId<0)
+        return;
+    mvnLocalEpoch[nId].store(mnGlobalEpoch.load());
+}
+
+EpochManager::Batch& EpochManager::CurrentBatch()
+{
+    const unsigned long nEpoch = mnGlobalEpoch.load();
+    if(mdBatches.empty() || mdBatches.back().nEpoch!=nEpoch || mdBatches.back().bUnlinked)
+    {
+        mdBatches.push_back(Batch());
+        mdBatches.back().nEpoch = nEpoch;
+        mdBatches.back().bUnlinked = false;
+    }
+    return mdBatches.back();
+}
+
+void EpochManager::Retire(MapPoint* pMP, const std::vector<KeyFrame*> &vpObservers)
+{
+    std::unique_lock<std::mutex> lock(mMutexRetired);
+    Batch &batch = CurrentBatch();
+    batch.vpMapPoints.push_back(pMP);
+    batch.vpCandidateKFs.insert(batch.vpCandidateKFs.end(),vpObservers.begin(),vpObservers.end());
+}
+
+void EpochManager::Retire(KeyFrame* pKF)
+{
+    std::unique_lock<std::mutex> lock(mMutexRetired);
+    CurrentBatch().vpKeyFrames.push_back(pKF);
+}
+
+void EpochManager::AddLinkCandidate(KeyFrame* pKF)
+{
+    std::unique_lock<std::mutex> lock(mMutexRetired);
+    for(size_t i=0; i<mdBatches.size(); i++)
+    {
+        Batch &batch = mdBatches[i];
+        if(!batch.bUnlinked && !batch.vpMapPoints.empty())
+            batch.vpCandidateKFs.push_back(pKF);
+    }
+}
+
+void EpochManager::TryAdvance()
+{
+    const unsigned long nEpoch = mnGlobalEpoch.load();
+    for(int i=0; i<MAX_PARTICIPANTS; i++)
+    {
+        if(mvbActive[i].load() && mvnLocalEpoch[i].load()!=nEpoch)
+            return;
+    }
+    mnGlobalEpoch.store(nEpoch+1);
+}
+
+size_t EpochManager::Reclaim(Atlas* pAtlas)
+{
+    std::unique_lock<std::mutex> lockReclaim(mMutexReclaim);
+
+    TryAdvance();
+    const unsigned long nEpoch = mnGlobalEpoch.load();
+
+    // Batches are ordered by epoch
+    std::vector<Batch> vReady;
+    {
+        std::unique_lock<std::mutex> lock(mMutexRetired);
+        while(!mdBatches.empty() && mdBatches.front().nEpoch+GRACE_EPOCHS<=nEpoch)
+        {
+            vReady.push_back(mdBatches.front());
+            mdBatches.pop_front();
+        }
+    }
+
+    if(vReady.empty())
+        return 0;
+
+    size_t nBytes = 0;
+    std::vector<Batch> vUnlinked;
+    for(size_t i=0; i<vReady.size(); i++)
+    {
+        if(vReady[i].bUnlinked)
+            nBytes += Release(vReady[i]);
+        else
+        {
+            Unlink(vReady[i],pAtlas);
+            vReady[i].bUnlinked = true;
+            vReady[i].nEpoch = nEpoch;
+            vUnlinked.push_back(vReady[i]);
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mMutexRetired);
+        for(size_t i=0; i<vUnlinked.size(); i++)
+            mdBatches.push_back(vUnlinked[i]);
+        mnReclaimedBytes += nBytes;
+    }
+
+    return nBytes;
+}
+
+void EpochManager::Unlink(Batch &batch, Atlas* pAtlas)
+{
+    std::unordered_set<MapPoint*> spMPs(batch.vpMapPoints.begin(),batch.vpMapPoints.end());
+
+    // Keyframes can still point to a retired point if the match was added after the point was culled:
+    // they observed it, were inserted in a map during the grace period or tried to observe it once bad.
+    // Bad keyframes waiting to be released keep their matches too
+    if(!spMPs.empty())
+    {
+        std::unordered_set<KeyFrame*> spCandidateKFs(batch.vpCandidateKFs.begin(),batch.vpCandidateKFs.end());
+        {
+            std::unique_lock<std::mutex> lock(mMutexRetired);
+            for(size_t i=0; i<mdBatches.size(); i++)
+                spCandidateKFs.insert(mdBatches[i].vpKeyFrames.begin(),mdBatches[i].vpKeyFrames.end());
+        }
+        spCandidateKFs.insert(batch.vpKeyFrames.begin(),batch.vpKeyFrames.end());
+
+        for(KeyFrame* pKF : spCandidateKFs)
+            pKF->EraseMapPointMatches(spMPs);
+    }
+
+    // A map merge may have inserted again an element that was already bad
+    std::vector<Map*> vpMaps = pAtlas->GetAllMaps();
+    for(Map* pMap : vpMaps)
+    {
+        for(KeyFrame* pKF : batch.vpKeyFrames)
+            pMap->EraseKeyFrame(pKF);
+
+        if(!spMPs.empty())
+        {
+            for(MapPoint* pMP : batch.vpMapPoints)
+                pMap->EraseMapPoint(pMP);
+            pMap->EraseReferenceMapPoints(spMPs);
+        }
+    }
+}
+
+size_t EpochManager::Release(Batch &batch)
+{
+    size_t nBytes = 0;
+    for(MapPoint* pMP : batch.vpMapPoints)
+    {
+        nBytes += pMP->GetMemoryUsage();
+        delete pMP;
+    }
+
+    for(KeyFrame* pKF : batch.vpKeyFrames)
+        nBytes += pKF->ReleaseFeatures();
+
+    return nBytes;
+}
+
+size_t EpochManager::GetReclaimedBytes()
+{
+    std::unique_lock<std::mutex> lock(mMutexRetired);
+    return mnReclaimedBytes;
+}
+
+size_t EpochManager::GetPendingObjects()
+{
+    std::unique_lock<std::mutex> lock(mMutexRetired);
+    size_t n = 0;
+    for(size_t i=0; i<mdBatches.size(); i++)
+        n += mdBatches[i].vpMapPoints.size() + mdBatches[i].vpKeyFrames.size();
+    return n;
+}
+
+} //namespace ORB_SLAM
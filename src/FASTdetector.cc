@@ -0,0 +1,371 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* The corner test and score follow the FAST implementation of OpenCV (modules/features2d/src/fast.cpp):
+*
+*  Copyright (c) 2006, 2008 Edward Rosten
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above copyright
+*     notice, this list of conditions and the following disclaimer in the
+*     documentation and/or other materials provided with the distribution.
+*   * Neither the name of the University of Cambridge nor the names of
+*     its contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+*  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+*  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+*  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+*  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+*  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+*  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FASTdetector.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FAST_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+    // Bresenham circle of radius 3, the first 9 pixels are repeated to test contiguous arcs
+    static const int offsets16[16][2] =
+            {
+                    {0,  3}, { 1,  3}, { 2,  2}, { 3,  1}, { 3, 0}, { 3, -1}, { 2, -2}, { 1, -3},
+                    {0, -3}, {-1, -3}, {-2, -2}, {-3, -1}, {-3, 0}, {-3,  1}, {-2,  2}, {-1,  3}
+            };
+
+    static void makeOffsets(int pixel[25], int rowStride)
+    {
+        int k = 0;
+        for( ; k < 16; k++ )
+            pixel[k] = offsets16[k][0] + offsets16[k][1] * rowStride;
+        for( ; k < 25; k++ )
+            pixel[k] = pixel[k - 16];
+    }
+
+    // Largest threshold for which ptr is still a corner. Returns threshold-1 if it is not a corner.
+    static int cornerScore(const uchar* ptr, const int pixel[], int threshold)
+    {
+        const int K = 8, N = K*3 + 1;
+        int k, v = ptr[0];
+        short d[N];
+        for( k = 0; k < N; k++ )
+            d[k] = (short)(v - ptr[pixel[k]]);
+
+        int a0 = threshold;
+        for( k = 0; k < 16; k += 2 )
+        {
+            int a = std::min((int)d[k+1], (int)d[k+2]);
+            a = std::min(a, (int)d[k+3]);
+            if( a <= a0 )
+                continue;
+            a = std::min(a, (int)d[k+4]);
+            a = std::min(a, (int)d[k+5]);
+            a = std::min(a, (int)d[k+6]);
+            a = std::min(a, (int)d[k+7]);
+            a = std::min(a, (int)d[k+8]);
+            a0 = std::max(a0, std::min(a, (int)d[k]));
+            a0 = std::max(a0, std::min(a, (int)d[k+9]));
+        }
+
+        int b0 = -a0;
+        for( k = 0; k < 16; k += 2 )
+        {
+            int b = std::max((int)d[k+1], (int)d[k+2]);
+            b = std::max(b, (int)d[k+3]);
+            b = std::max(b, (int)d[k+4]);
+            b = std::max(b, (int)d[k+5]);
+            if( b >= b0 )
+                continue;
+            b = std::max(b, (int)d[k+6]);
+            b = std::max(b, (int)d[k+7]);
+            b = std::max(b, (int)d[k+8]);
+
+            b0 = std::min(b0, std::max(b, (int)d[k]));
+            b0 = std::min(b0, std::max(b, (int)d[k+9]));
+        }
+
+        return -b0 - 1;
+    }
+
+    static void scoreRowScalar(const uchar* ptr, uchar* score, const int n, const int pixel[25], const int th)
+    {
+        for(int k = 0; k < n; k++, ptr++)
+        {
+            // A contiguous arc of 9 pixels always contains two consecutive compass points
+            const int v = ptr[0];
+            const int p0 = ptr[pixel[0]], p4 = ptr[pixel[4]], p8 = ptr[pixel[8]], p12 = ptr[pixel[12]];
+            const int b0 = p0 > v+th, b4 = p4 > v+th, b8 = p8 > v+th, b12 = p12 > v+th;
+            const int d0 = p0 < v-th, d4 = p4 < v-th, d8 = p8 < v-th, d12 = p12 < v-th;
+            if(!((b0&b4) | (b4&b8) | (b8&b12) | (b12&b0) | (d0&d4) | (d4&d8) | (d8&d12) | (d12&d0)))
+            {
+                score[k] = 0;
+                continue;
+            }
+
+            const int s = cornerScore(ptr, pixel, th);
+            score[k] = s >= th ? (uchar)s : 0;
+        }
+    }
+
+#ifdef FAST_X86_DISPATCH
+
+    __attribute__((target("sse2")))
+    static void scoreRowSSE2(const uchar* ptr, uchar* score, const int n, const int pixel[25], const int th)
+    {
+        const __m128i delta = _mm_set1_epi8(-128), t = _mm_set1_epi8((char)th), K8 = _mm_set1_epi8(8);
+
+        int k = 0;
+        for( ; k <= n - 16; k += 16, ptr += 16 )
+        {
+            __m128i m0, m1;
+            __m128i v0 = _mm_loadu_si128((const __m128i*)ptr);
+            __m128i v1 = _mm_xor_si128(_mm_subs_epu8(v0, t), delta);
+            v0 = _mm_xor_si128(_mm_adds_epu8(v0, t), delta);
+
+            __m128i x0 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[0])), delta);
+            __m128i x1 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[4])), delta);
+            __m128i x2 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[8])), delta);
+            __m128i x3 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[12])), delta);
+            m0 = _mm_and_si128(_mm_cmpgt_epi8(x0, v0), _mm_cmpgt_epi8(x1, v0));
+            m1 = _mm_and_si128(_mm_cmpgt_epi8(v1, x0), _mm_cmpgt_epi8(v1, x1));
+            m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x1, v0), _mm_cmpgt_epi8(x2, v0)));
+            m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x1), _mm_cmpgt_epi8(v1, x2)));
+            m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x2, v0), _mm_cmpgt_epi8(x3, v0)));
+            m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x2), _mm_cmpgt_epi8(v1, x3)));
+            m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x3, v0), _mm_cmpgt_epi8(x0, v0)));
+            m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x3), _mm_cmpgt_epi8(v1, x0)));
+            m0 = _mm_or_si128(m0, m1);
+
+            _mm_storeu_si128((__m128i*)(score + k), _mm_setzero_si128());
+
+            if(_mm_movemask_epi8(m0) == 0)
+                continue;
+
+            // Length of the longest run of brighter (c0) and darker (c1) pixels around the circle
+            __m128i c0 = _mm_setzero_si128(), c1 = c0, max0 = c0, max1 = c0;
+            for(int i = 0; i < 25; i++)
+            {
+                __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ptr + pixel[i])), delta);
+                m0 = _mm_cmpgt_epi8(x, v0);
+                m1 = _mm_cmpgt_epi8(v1, x);
+
+                c0 = _mm_and_si128(_mm_sub_epi8(c0, m0), m0);
+                c1 = _mm_and_si128(_mm_sub_epi8(c1, m1), m1);
+
+                max0 = _mm_max_epu8(max0, c0);
+                max1 = _mm_max_epu8(max1, c1);
+            }
+
+            max0 = _mm_max_epu8(max0, max1);
+            int m = _mm_movemask_epi8(_mm_cmpgt_epi8(max0, K8));
+
+            for(int i = 0; m > 0 && i < 16; i++, m >>= 1)
+                if(m & 1)
+                    score[k+i] = (uchar)cornerScore(ptr+i, pixel, th);
+        }
+
+        scoreRowScalar(ptr, score + k, n - k, pixel, th);
+    }
+
+    __attribute__((target("avx2")))
+    static void scoreRowAVX2(const uchar* ptr, uchar* score, const int n, const int pixel[25], const int th)
+    {
+        const __m256i delta = _mm256_set1_epi8(-128), t = _mm256_set1_epi8((char)th), K8 = _mm256_set1_epi8(8);
+
+        int k = 0;
+        for( ; k <= n - 32; k += 32, ptr += 32 )
+        {
+            __m256i m0, m1;
+            __m256i v0 = _mm256_loadu_si256((const __m256i*)ptr);
+            __m256i v1 = _mm256_xor_si256(_mm256_subs_epu8(v0, t), delta);
+            v0 = _mm256_xor_si256(_mm256_adds_epu8(v0, t), delta);
+
+            __m256i x0 = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(ptr + pixel[0])), delta);
+            __m256i x1 = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(ptr + pixel[4])), delta);
+            __m256i x2 = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(ptr + pixel[8])), delta);
+            __m256i x3 = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(ptr + pixel[12])), delta);
+            m0 = _mm256_and_si256(_mm256_cmpgt_epi8(x0, v0), _mm256_cmpgt_epi8(x1, v0));
+            m1 = _mm256_and_si256(_mm256_cmpgt_epi8(v1, x0), _mm256_cmpgt_epi8(v1, x1));
+            m0 = _mm256_or_si256(m0, _mm256_and_si256(_mm256_cmpgt_epi8(x1, v0), _mm256_cmpgt_epi8(x2, v0)));
+            m1 = _mm256_or_si256(m1, _mm256_and_si256(_mm256_cmpgt_epi8(v1, x1), _mm256_cmpgt_epi8(v1, x2)));
+            m0 = _mm256_or_si256(m0, _mm256_and_si256(_mm256_cmpgt_epi8(x2, v0), _mm256_cmpgt_epi8(x3, v0)));
+            m1 = _mm256_or_si256(m1, _mm256_and_si256(_mm256_cmpgt_epi8(v1, x2), _mm256_cmpgt_epi8(v1, x3)));
+            m0 = _mm256_or_si256(m0, _mm256_and_si256(_mm256_cmpgt_epi8(x3, v0), _mm256_cmpgt_epi8(x0, v0)));
+            m1 = _mm256_or_si256(m1, _mm256_and_si256(_mm256_cmpgt_epi8(v1, x3), _mm256_cmpgt_epi8(v1, x0)));
+            m0 = _mm256_or_si256(m0, m1);
+
+            _mm256_storeu_si256((__m256i*)(score + k), _mm256_setzero_si256());
+
+            if(_mm256_movemask_epi8(m0) == 0)
+                continue;
+
+            __m256i c0 = _mm256_setzero_si256(), c1 = c0, max0 = c0, max1 = c0;
+            for(int i = 0; i < 25; i++)
+            {
+                __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(ptr + pixel[i])), delta);
+                m0 = _mm256_cmpgt_epi8(x, v0);
+                m1 = _mm256_cmpgt_epi8(v1, x);
+
+                c0 = _mm256_and_si256(_mm256_sub_epi8(c0, m0), m0);
+                c1 = _mm256_and_si256(_mm256_sub_epi8(c1, m1), m1);
+
+                max0 = _mm256_max_epu8(max0, c0);
+                max1 = _mm256_max_epu8(max1, c1);
+            }
+
+            max0 = _mm256_max_epu8(max0, max1);
+            unsigned int m = (unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(max0, K8));
+
+            for(int i = 0; m != 0 && i < 32; i++, m >>= 1)
+                if(m & 1)
+                    score[k+i] = (uchar)cornerScore(ptr+i, pixel, th);
+        }
+
+        scoreRowScalar(ptr, score + k, n - k, pixel, th);
+    }
+
+#endif
+
+    static FASTdetector::Backend detectBackend()
+    {
+#ifdef FAST_X86_DISPATCH
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return FASTdetector::AVX2;
+        if(__builtin_cpu_supports("sse2"))
+            return FASTdetector::SSE2;
+#endif
+        return FASTdetector::SCALAR;
+    }
+
+    FASTdetector::Backend FASTdetector::GetBackend()
+    {
+        static const Backend backend = detectBackend();
+        return backend;
+    }
+
+    const char* FASTdetector::GetBackendName()
+    {
+        switch(GetBackend())
+        {
+            case AVX2:
+                return "AVX2";
+            case SSE2:
+                return "SSE2";
+            default:
+                return "scalar";
+        }
+    }
+
+    void FASTdetector::ComputeScores(const cv::Mat &img, cv::Mat &scores, int th,
+                                     const int minX, const int maxX, const int minY, const int maxY)
+    {
+        CV_Assert(img.type() == CV_8UC1);
+
+        th = std::min(std::max(th, 0), 255);
+
+        scores.create(img.rows, img.cols, CV_8U);
+
+        const int n = maxX - minX;
+        if(n <= 0)
+            return;
+
+        int pixel[25];
+        makeOffsets(pixel, (int)img.step);
+
+        const Backend backend = GetBackend();
+
+        for(int y = minY; y < maxY; y++)
+        {
+            const uchar* ptr = img.ptr<uchar>(y) + minX;
+            uchar* score = scores.ptr<uchar>(y) + minX;
+
+#ifdef FAST_X86_DISPATCH
+            if(backend == AVX2)
+            {
+                scoreRowAVX2(ptr, score, n, pixel, th);
+                continue;
+            }
+            else if(backend == SSE2)
+            {
+                scoreRowSSE2(ptr, score, n, pixel, th);
+                continue;
+            }
+#endif
+            scoreRowScalar(ptr, score, n, pixel, th);
+        }
+    }
+
+    void FASTdetector::DetectInCell(const cv::Mat &scores, const int th, const int iniX, const int iniY,
+                                    const int maxX, const int maxY, std::vector<cv::KeyPoint> &vKeys)
+    {
+        // cv::FAST only detects 3 pixels away from the borders of the cell and
+        // compares against 0 outside that area during non-maximum suppression
+        const int x0 = iniX + 3, x1 = maxX - 3;
+        const int y0 = iniY + 3, y1 = maxY - 3;
+
+        for(int y = y0; y < y1; y++)
+        {
+            const uchar* prev = y > y0 ? scores.ptr<uchar>(y-1) : NULL;
+            const uchar* curr = scores.ptr<uchar>(y);
+            const uchar* next = y < y1-1 ? scores.ptr<uchar>(y+1) : NULL;
+
+            for(int x = x0; x < x1; x++)
+            {
+                const int s = curr[x];
+                if(s < th || s == 0)
+                    continue;
+
+                const bool bLeft = x > x0, bRight = x < x1-1;
+
+                if(bLeft && s <= curr[x-1])
+                    continue;
+                if(bRight && s <= curr[x+1])
+                    continue;
+                if(prev && (s <= prev[x] || (bLeft && s <= prev[x-1]) || (bRight && s <= prev[x+1])))
+                    continue;
+                if(next && (s <= next[x] || (bLeft && s <= next[x-1]) || (bRight && s <= next[x+1])))
+                    continue;
+
+                vKeys.push_back(cv::KeyPoint((float)(x-iniX), (float)(y-iniY), 7.f, -1, (float)s));
+            }
+        }
+    }
+
+} //namespace ORB_SLAM
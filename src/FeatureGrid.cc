@@ -0,0 +1,56 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FeatureGrid.h"
+
+#include <utility>
+
+namespace ORB_SLAM3
+{
+
+FeatureGrid::FeatureGrid(): mnCols(0), mnRows(0)
+{
+}
+
+void FeatureGrid::Assign(const int nCols, const int nRows, const std::vector<int> &vCellOfKey)
+{
+    mnCols = nCols;
+    mnRows = nRows;
+
+    const int nCells = nCols*nRows;
+
+    // Counting sort of the keypoints by cell
+    std::vector<int> vCellStart(nCells+1,0);
+    for(size_t i=0; i<vCellOfKey.size(); i++)
+        if(vCellOfKey[i]>=0)
+            vCellStart[vCellOfKey[i]+1]++;
+
+    for(int c=0; c<nCells; c++)
+        vCellStart[c+1] += vCellStart[c];
+
+    std::vector<int> vIndices(vCellStart[nCells]);
+    std::vector<int> vFill(vCellStart.begin(),vCellStart.end()-1);
+    for(size_t i=0; i<vCellOfKey.size(); i++)
+        if(vCellOfKey[i]>=0)
+            vIndices[vFill[vCellOfKey[i]]++] = i;
+
+    mvCellStart = std::move(vCellStart);
+    mvIndices = std::move(vIndices);
+}
+
+} //namespace ORB_SLAM
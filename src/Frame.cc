@@ -25,11 +25,19 @@
 #include "Converter.h"
 #include "ORBmatcher.h"
 #include "GeometricCamera.h"
+#include "ThreadPool.h"
+#include "UndistortionLUT.h"
+#include "MapPointSnapshot.h"
 
 #include <thread>
 #include <include/CameraModels/Pinhole.h>
 #include <include/CameraModels/KannalaBrandt8.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRAME_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 namespace ORB_SLAM3
 {
 
@@ -39,14 +47,16 @@ float Frame::cx, Frame::cy, Frame::fx, Frame::fy, Frame::invfx, Frame::invfy;
 float Frame::mnMinX, Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY;
 float Frame::mfGridElementWidthInv, Frame::mfGridElementHeightInv;
 
-//For stereo fisheye matching
-cv::BFMatcher Frame::BFmatcher = cv::BFMatcher(cv::NORM_HAMMING);
+ThreadPool* Frame::mpExtractorPool = NULL;
+UndistortionLUT* Frame::mpUndistortionLUT = NULL;
 
 Frame::Frame(): mpcpi(NULL), mpImuPreintegrated(NULL), mpPrevFrame(NULL), mpImuPreintegratedFrame(NULL), mpReferenceKF(static_cast<KeyFrame*>(NULL)), mbIsSet(false), mbImuPreintegrated(false), mbHasPose(false), mbHasVelocity(false)
 {
 #ifdef REGISTER_TIMES
     mTimeStereoMatch = 0;
     mTimeORB_Ext = 0;
+    mTimeORB_ExtLeft = 0;
+    mTimeORB_ExtRight = 0;
 #endif
 }
 
@@ -58,7 +68,7 @@ Frame::Frame(const Frame &frame)
      mbf(frame.mbf), mb(frame.mb), mThDepth(frame.mThDepth), N(frame.N), mvKeys(frame.mvKeys),
      mvKeysRight(frame.mvKeysRight), mvKeysUn(frame.mvKeysUn), mvuRight(frame.mvuRight),
      mvDepth(frame.mvDepth), mBowVec(frame.mBowVec), mFeatVec(frame.mFeatVec),
-     mDescriptors(frame.mDescriptors.clone()), mDescriptorsRight(frame.mDescriptorsRight.clone()),
+     mDescriptors(frame.mDescriptors), mDescriptorsRight(frame.mDescriptorsRight),
      mvpMapPoints(frame.mvpMapPoints), mvbOutlier(frame.mvbOutlier), mImuCalib(frame.mImuCalib), mnCloseMPs(frame.mnCloseMPs),
      mpImuPreintegrated(frame.mpImuPreintegrated), mpImuPreintegratedFrame(frame.mpImuPreintegratedFrame), mImuBias(frame.mImuBias),
      mnId(frame.mnId), mpReferenceKF(frame.mpReferenceKF), mnScaleLevels(frame.mnScaleLevels),
@@ -70,16 +80,8 @@ Frame::Frame(const Frame &frame)
      monoLeft(frame.monoLeft), monoRight(frame.monoRight), mvLeftToRightMatch(frame.mvLeftToRightMatch),
      mvRightToLeftMatch(frame.mvRightToLeftMatch), mvStereo3Dpoints(frame.mvStereo3Dpoints),
      mTlr(frame.mTlr), mRlr(frame.mRlr), mtlr(frame.mtlr), mTrl(frame.mTrl),
-     mTcw(frame.mTcw), mbHasPose(false), mbHasVelocity(false)
+     mTcw(frame.mTcw), mbHasPose(false), mbHasVelocity(false), mGrid(frame.mGrid), mGridRight(frame.mGridRight)
 {
-    for(int i=0;i<FRAME_GRID_COLS;i++)
-        for(int j=0; j<FRAME_GRID_ROWS; j++){
-            mGrid[i][j]=frame.mGrid[i][j];
-            if(frame.Nleft > 0){
-                mGridRight[i][j] = frame.mGridRight[i][j];
-            }
-        }
-
     if(frame.mbHasPose)
         SetPose(frame.GetPose());
 
@@ -94,6 +96,8 @@ Frame::Frame(const Frame &frame)
 #ifdef REGISTER_TIMES
     mTimeStereoMatch = frame.mTimeStereoMatch;
     mTimeORB_Ext = frame.mTimeORB_Ext;
+    mTimeORB_ExtLeft = frame.mTimeORB_ExtLeft;
+    mTimeORB_ExtRight = frame.mTimeORB_ExtRight;
 #endif
 }
 
@@ -119,10 +123,7 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,0,0);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight,0,0);
-    threadLeft.join();
-    threadRight.join();
+    ExtractORBStereo(imLeft,imRight,0,0,0,0);
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndExtORB = std::chrono::steady_clock::now();
 
@@ -384,20 +385,10 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extra
 
 void Frame::AssignFeaturesToGrid()
 {
-    // Fill matrix with points
-    const int nCells = FRAME_GRID_COLS*FRAME_GRID_ROWS;
-
-    int nReserve = 0.5f*N/(nCells);
-
-    for(unsigned int i=0; i<FRAME_GRID_COLS;i++)
-        for (unsigned int j=0; j<FRAME_GRID_ROWS;j++){
-            mGrid[i][j].reserve(nReserve);
-            if(Nleft != -1){
-                mGridRight[i][j].reserve(nReserve);
-            }
-        }
-
-
+    // Cell of every keypoint, the left and right images have their own grid
+    const int nLeft = (Nleft == -1) ? N : Nleft;
+    vector<int> vCellLeft(nLeft,-1);
+    vector<int> vCellRight(N-nLeft,-1);
 
     for(int i=0;i<N;i++)
     {
@@ -407,21 +398,60 @@ void Frame::AssignFeaturesToGrid()
 
         int nGridPosX, nGridPosY;
         if(PosInGrid(kp,nGridPosX,nGridPosY)){
-            if(Nleft == -1 || i < Nleft)
-                mGrid[nGridPosX][nGridPosY].push_back(i);
+            if(i < nLeft)
+                vCellLeft[i] = nGridPosX*FRAME_GRID_ROWS+nGridPosY;
             else
-                mGridRight[nGridPosX][nGridPosY].push_back(i - Nleft);
+                vCellRight[i - nLeft] = nGridPosX*FRAME_GRID_ROWS+nGridPosY;
         }
     }
+
+    mGrid.Assign(FRAME_GRID_COLS,FRAME_GRID_ROWS,vCellLeft);
+    if(Nleft != -1)
+        mGridRight.Assign(FRAME_GRID_COLS,FRAME_GRID_ROWS,vCellRight);
 }
 
 void Frame::ExtractORB(int flag, const cv::Mat &im, const int x0, const int x1)
 {
     vector<int> vLapping = {x0,x1};
     if(flag==0)
-        monoLeft = (*mpORBextractorLeft)(im,cv::Mat(),mvKeys,mDescriptors,vLapping);
+        monoLeft = (*mpORBextractorLeft)(im,cv::Mat(),mvKeys.Edit(),mDescriptors,vLapping);
     else
-        monoRight = (*mpORBextractorRight)(im,cv::Mat(),mvKeysRight,mDescriptorsRight,vLapping);
+        monoRight = (*mpORBextractorRight)(im,cv::Mat(),mvKeysRight.Edit(),mDescriptorsRight,vLapping);
+}
+
+void Frame::ExtractORBStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const int x0Left, const int x1Left,
+                             const int x0Right, const int x1Right)
+{
+    if(!mpExtractorPool || mpExtractorPool->GetNumThreads()==0)
+    {
+        thread threadLeft(&Frame::ExtractORB,this,0,imLeft,x0Left,x1Left);
+        thread threadRight(&Frame::ExtractORB,this,1,imRight,x0Right,x1Right);
+        threadLeft.join();
+        threadRight.join();
+#ifdef REGISTER_TIMES
+        mTimeORB_ExtLeft = 0;
+        mTimeORB_ExtRight = 0;
+#endif
+        return;
+    }
+
+    double timeRight = 0;
+    std::future<void> right = mpExtractorPool->Submit([&]{ExtractORB(1,imRight,x0Right,x1Right);}, &timeRight);
+
+#ifdef REGISTER_TIMES
+    std::chrono::steady_clock::time_point time_StartLeft = std::chrono::steady_clock::now();
+#endif
+    ExtractORB(0,imLeft,x0Left,x1Left);
+#ifdef REGISTER_TIMES
+    std::chrono::steady_clock::time_point time_EndLeft = std::chrono::steady_clock::now();
+#endif
+
+    right.get();
+
+#ifdef REGISTER_TIMES
+    mTimeORB_ExtLeft = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndLeft - time_StartLeft).count();
+    mTimeORB_ExtRight = timeRight;
+#endif
 }
 
 bool Frame::isSet() const {
@@ -585,6 +615,183 @@ bool Frame::isInFrustum(MapPoint *pMP, float viewingCosLimit)
     }
 }
 
+// Projection to camera coordinates and the distance and viewing angle checks of n points. Both checks are
+// done on squared values so that there is no sqrt (a libm call with errno) and no branch in the loop, and
+// the arrays are __restrict so that no aliasing checks are needed: gcc vectorizes it at -O3
+// (checked with -fopt-info-vec on g++ 12, with and without -march=native).
+// Outputs the squared depth and distance, and the dot product of the viewing direction with the normal.
+static void CullPoints(const int n, const float* __restrict pX, const float* __restrict pY, const float* __restrict pZ,
+                       const float* __restrict pNx, const float* __restrict pNy, const float* __restrict pNz,
+                       const float* __restrict pMinDist, const float* __restrict pMaxDist,
+                       const Eigen::Matrix3f &R, const Eigen::Vector3f &t, const Eigen::Vector3f &O, const float viewingCosLimit,
+                       float* __restrict pXc, float* __restrict pYc, float* __restrict pZc, float* __restrict pDepth2,
+                       float* __restrict pDist2, float* __restrict pDot, unsigned char* __restrict pInView)
+{
+    const float r00 = R(0,0), r01 = R(0,1), r02 = R(0,2);
+    const float r10 = R(1,0), r11 = R(1,1), r12 = R(1,2);
+    const float r20 = R(2,0), r21 = R(2,1), r22 = R(2,2);
+    const float tx = t(0), ty = t(1), tz = t(2);
+    const float ox = O(0), oy = O(1), oz = O(2);
+
+    // viewCos>=limit <=> dot>=limit*dist <=> dot*|dot|>=limit*|limit|*dist^2, since x*|x| is increasing
+    const float cosLimit2 = viewingCosLimit*std::fabs(viewingCosLimit);
+
+    for(int i=0; i<n; i++)
+    {
+        // 3D in camera coordinates
+        const float xc = r00*pX[i] + r01*pY[i] + r02*pZ[i] + tx;
+        const float yc = r10*pX[i] + r11*pY[i] + r12*pZ[i] + ty;
+        const float zc = r20*pX[i] + r21*pY[i] + r22*pZ[i] + tz;
+
+        // Distance and viewing angle from the camera center
+        const float pox = pX[i]-ox, poy = pY[i]-oy, poz = pZ[i]-oz;
+        const float dist2 = pox*pox + poy*poy + poz*poz;
+        const float dot = pox*pNx[i] + poy*pNy[i] + poz*pNz[i];
+        const float minDist = 0.8f*pMinDist[i], maxDist = 1.2f*pMaxDist[i];
+
+        pXc[i] = xc;
+        pYc[i] = yc;
+        pZc[i] = zc;
+        pDepth2[i] = xc*xc + yc*yc + zc*zc;
+        pDist2[i] = dist2;
+        pDot[i] = dot;
+        pInView[i] = (zc>=0.0f) & (dist2>0.0f) & (dist2>=minDist*minDist) & (dist2<=maxDist*maxDist) &
+                     (dot*std::fabs(dot)>=cosLimit2*dist2);
+    }
+}
+
+// Frustum checks of all the snapshot points for one camera. The culling and the image bounds loops are
+// vectorized, the projection runs as one batch of the camera model and the square roots are only taken
+// for the points in view.
+static void CheckViewInFrustum(const MapPointSnapshot &points, MapPointSnapshot::View &view, GeometricCamera* pCamera,
+                               const Eigen::Matrix3f &R, const Eigen::Vector3f &t, const Eigen::Vector3f &O,
+                               const float viewingCosLimit, const float minX, const float maxX, const float minY, const float maxY)
+{
+    const int n = points.size();
+    view.resize(n);
+
+    float* pU = view.mvU.data();
+    float* pV = view.mvV.data();
+    float* pDepth = view.mvDepth.data();
+    float* pDist = view.mvDist.data();
+    float* pViewCos = view.mvViewCos.data();
+    unsigned char* pInView = view.mvbInView.data();
+
+    CullPoints(n,points.mvX.data(),points.mvY.data(),points.mvZ.data(),points.mvNx.data(),points.mvNy.data(),points.mvNz.data(),
+               points.mvMinDistance.data(),points.mvMaxDistance.data(),R,t,O,viewingCosLimit,
+               view.mvXc.data(),view.mvYc.data(),view.mvZc.data(),pDepth,pDist,pViewCos,pInView);
+
+    pCamera->projectBatch(view.mvXc.data(),view.mvYc.data(),view.mvZc.data(),n,pU,pV);
+
+    for(int i=0; i<n; i++)
+        pInView[i] &= (pU[i]>=minX) & (pU[i]<=maxX) & (pV[i]>=minY) & (pV[i]<=maxY);
+
+    for(int i=0; i<n; i++)
+    {
+        if(!pInView[i])
+            continue;
+        pDepth[i] = std::sqrt(pDepth[i]);
+        pDist[i] = std::sqrt(pDist[i]);
+        pViewCos[i] /= pDist[i];
+    }
+}
+
+// MapPoint::PredictScale with the snapshot of mfMaxDistance
+static inline int PredictScale(const float maxDistance, const float dist, const float logScaleFactor, const int nScaleLevels)
+{
+    const float ratio = maxDistance/dist;
+    int nScale = ceil(log(ratio)/logScaleFactor);
+    if(nScale<0)
+        nScale = 0;
+    else if(nScale>=nScaleLevels)
+        nScale = nScaleLevels-1;
+
+    return nScale;
+}
+
+int Frame::isInFrustum(MapPointSnapshot &points, float viewingCosLimit, vector<MapPoint*> &vpInView)
+{
+    vpInView.clear();
+    const int n = points.size();
+
+    CheckViewInFrustum(points,points.mLeft,mpCamera,mRcw,mtcw,mOw,viewingCosLimit,mnMinX,mnMaxX,mnMinY,mnMaxY);
+    if(Nleft != -1)
+    {
+        const Eigen::Matrix3f Rrl = mTrl.rotationMatrix();
+        const Eigen::Vector3f trl = mTrl.translation();
+        const Eigen::Matrix3f Rr = Rrl * mRcw;
+        const Eigen::Vector3f tr = Rrl * mtcw + trl;
+        const Eigen::Vector3f Or = mRwc * mTlr.translation() + mOw;
+        CheckViewInFrustum(points,points.mRight,mpCamera2,Rr,tr,Or,viewingCosLimit,mnMinX,mnMaxX,mnMinY,mnMaxY);
+    }
+
+    const MapPointSnapshot::View &left = points.mLeft;
+    const MapPointSnapshot::View &right = points.mRight;
+    const float* pMaxDist = points.mvMaxDistance.data();
+
+    for(int i=0; i<n; i++)
+    {
+        MapPoint* pMP = points.mvpMapPoints[i];
+
+        // Points already matched in this frame keep their tracking data
+        if(pMP->mnLastFrameSeen == mnId)
+            continue;
+
+        const bool bInView = left.mvbInView[i];
+        const bool bInViewR = Nleft != -1 && right.mvbInView[i];
+
+        if(!bInView && !bInViewR)
+        {
+            pMP->mbTrackInView = false;
+            pMP->mbTrackInViewR = false;
+            continue;
+        }
+
+        if(pMP->isBad())
+            continue;
+
+        if(Nleft == -1)
+        {
+            // Data used by the tracking
+            pMP->mbTrackInView = true;
+            pMP->mTrackProjX = left.mvU[i];
+            pMP->mTrackProjXR = left.mvU[i] - mbf*(1.0f/left.mvZc[i]);
+            pMP->mTrackDepth = left.mvDepth[i];
+            pMP->mTrackProjY = left.mvV[i];
+            pMP->mnTrackScaleLevel = PredictScale(pMaxDist[i],left.mvDist[i],mfLogScaleFactor,mnScaleLevels);
+            pMP->mTrackViewCos = left.mvViewCos[i];
+        }
+        else
+        {
+            pMP->mbTrackInView = bInView;
+            pMP->mbTrackInViewR = bInViewR;
+            pMP->mnTrackScaleLevel = -1;
+            pMP->mnTrackScaleLevelR = -1;
+
+            if(bInView)
+            {
+                pMP->mTrackProjX = left.mvU[i];
+                pMP->mTrackProjY = left.mvV[i];
+                pMP->mnTrackScaleLevel = PredictScale(pMaxDist[i],left.mvDist[i],mfLogScaleFactor,mnScaleLevels);
+                pMP->mTrackViewCos = left.mvViewCos[i];
+                pMP->mTrackDepth = left.mvDepth[i];
+            }
+            if(bInViewR)
+            {
+                pMP->mTrackProjXR = right.mvU[i];
+                pMP->mTrackProjYR = right.mvV[i];
+                pMP->mnTrackScaleLevelR = PredictScale(pMaxDist[i],right.mvDist[i],mfLogScaleFactor,mnScaleLevels);
+                pMP->mTrackViewCosR = right.mvViewCos[i];
+                pMP->mTrackDepthR = right.mvDepth[i];
+            }
+        }
+
+        vpInView.push_back(pMP);
+    }
+
+    return vpInView.size();
+}
+
 bool Frame::ProjectPointDistort(MapPoint* pMP, cv::Point2f &kp, float &u, float &v)
 {
 
@@ -688,19 +895,19 @@ vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const f
 
     const bool bCheckLevels = (minLevel>0) || (maxLevel>=0);
 
+    const FeatureGrid &grid = (!bRight) ? mGrid : mGridRight;
+    if(grid.empty())
+        return vIndices;
+
     for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
     {
         for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
         {
-            const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-            if(vCell.empty())
-                continue;
-
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
+            for(const int* pIdx=grid.CellBegin(ix,iy), *pEnd=grid.CellEnd(ix,iy); pIdx!=pEnd; pIdx++)
             {
-                const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[vCell[j]]
-                                                         : (!bRight) ? mvKeys[vCell[j]]
-                                                                     : mvKeysRight[vCell[j]];
+                const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[*pIdx]
+                                                         : (!bRight) ? mvKeys[*pIdx]
+                                                                     : mvKeysRight[*pIdx];
                 if(bCheckLevels)
                 {
                     if(kpUn.octave<minLevel)
@@ -714,7 +921,7 @@ vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const f
                 const float disty = kpUn.pt.y-y;
 
                 if(fabs(distx)<factorX && fabs(disty)<factorY)
-                    vIndices.push_back(vCell[j]);
+                    vIndices.push_back(*pIdx);
             }
         }
     }
@@ -752,6 +959,14 @@ void Frame::UndistortKeyPoints()
         return;
     }
 
+    if(mpUndistortionLUT)
+    {
+        vector<cv::KeyPoint> vKeysUn;
+        mpUndistortionLUT->Undistort(mvKeys,vKeysUn);
+        mvKeysUn = std::move(vKeysUn);
+        return;
+    }
+
     // Fill matrix with points
     cv::Mat mat(N,2,CV_32F);
 
@@ -768,14 +983,15 @@ void Frame::UndistortKeyPoints()
 
 
     // Fill undistorted keypoint vector
-    mvKeysUn.resize(N);
+    vector<cv::KeyPoint> vKeysUn(N);
     for(int i=0; i<N; i++)
     {
         cv::KeyPoint kp = mvKeys[i];
         kp.pt.x=mat.at<float>(i,0);
         kp.pt.y=mat.at<float>(i,1);
-        mvKeysUn[i]=kp;
+        vKeysUn[i]=kp;
     }
+    mvKeysUn = std::move(vKeysUn);
 
 }
 
@@ -808,35 +1024,112 @@ void Frame::ComputeImageBounds(const cv::Mat &imLeft)
     }
 }
 
+// SAD between the (2w+1)x(2w+1) window at pL and the windows at pR+inc, inc in [0,nInc).
+// Images are 8 bit and the results are exact.
+static void SlidingWindowSADScalar(const uchar* pL, const size_t stepL, const uchar* pR, const size_t stepR,
+                                   const int w, const int nInc, int* pDists)
+{
+    const int size = 2*w+1;
+    for(int inc=0; inc<nInc; inc++)
+    {
+        int dist = 0;
+        for(int y=0; y<size; y++)
+        {
+            const uchar* rowL = pL + y*stepL;
+            const uchar* rowR = pR + y*stepR + inc;
+            for(int x=0; x<size; x++)
+                dist += abs((int)rowL[x]-(int)rowR[x]);
+        }
+        pDists[inc] = dist;
+    }
+}
+
+#ifdef FRAME_X86_DISPATCH
+
+// Windows up to 16 pixels wide. Each row is read with one 16 byte load and the pixels beyond
+// the window are masked, so up to 15 bytes after the last window of a row are read.
+__attribute__((target("sse2")))
+static void SlidingWindowSADSSE2(const uchar* pL, const size_t stepL, const uchar* pR, const size_t stepR,
+                                 const int w, const int nInc, int* pDists)
+{
+    const int size = 2*w+1;
+    uchar maskBytes[16];
+    for(int i=0; i<16; i++)
+        maskBytes[i] = i<size ? 0xFF : 0;
+    const __m128i mask = _mm_loadu_si128((const __m128i*)maskBytes);
+
+    __m128i rowsL[16];
+    for(int y=0; y<size; y++)
+        rowsL[y] = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pL + y*stepL)),mask);
+
+    for(int inc=0; inc<nInc; inc++)
+    {
+        __m128i acc = _mm_setzero_si128();
+        for(int y=0; y<size; y++)
+        {
+            const __m128i rowR = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pR + y*stepR + inc)),mask);
+            acc = _mm_add_epi64(acc,_mm_sad_epu8(rowsL[y],rowR));
+        }
+        pDists[inc] = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc,acc));
+    }
+}
+
+#endif
+
+static void SlidingWindowSAD(const uchar* pL, const size_t stepL, const uchar* pR, const size_t stepR,
+                             const int w, const int nInc, int* pDists)
+{
+#ifdef FRAME_X86_DISPATCH
+    static const bool bSSE2 = __builtin_cpu_supports("sse2");
+    if(bSSE2 && 2*w+1<=16)
+    {
+        SlidingWindowSADSSE2(pL,stepL,pR,stepR,w,nInc,pDists);
+        return;
+    }
+#endif
+    SlidingWindowSADScalar(pL,stepL,pR,stepR,w,nInc,pDists);
+}
+
 void Frame::ComputeStereoMatches()
 {
     mvuRight = vector<float>(N,-1.0f);
     mvDepth = vector<float>(N,-1.0f);
+    vector<float> &vuRight = mvuRight.Edit();
+    vector<float> &vDepth = mvDepth.Edit();
 
     const int thOrbDist = (ORBmatcher::TH_HIGH+ORBmatcher::TH_LOW)/2;
 
     const int nRows = mpORBextractorLeft->mvImagePyramid[0].rows;
 
-    //Assign keypoints to row table
-    vector<vector<size_t> > vRowIndices(nRows,vector<size_t>());
-
-    for(int i=0; i<nRows; i++)
-        vRowIndices[i].reserve(200);
-
+    //Assign keypoints to row table. Right keypoints of each row are stored contiguously,
+    //row y spans [vRowStart[y],vRowStart[y+1]) in vRowIndices.
     const int Nr = mvKeysRight.size();
 
+    vector<int> vRowStart(nRows+1,0);
+    vector<int> vMinRow(Nr), vMaxRow(Nr);
+
     for(int iR=0; iR<Nr; iR++)
     {
         const cv::KeyPoint &kp = mvKeysRight[iR];
         const float &kpY = kp.pt.y;
         const float r = 2.0f*mvScaleFactors[mvKeysRight[iR].octave];
-        const int maxr = ceil(kpY+r);
-        const int minr = floor(kpY-r);
+        vMaxRow[iR] = min(nRows-1,(int)ceil(kpY+r));
+        vMinRow[iR] = max(0,(int)floor(kpY-r));
 
-        for(int yi=minr;yi<=maxr;yi++)
-            vRowIndices[yi].push_back(iR);
+        for(int yi=vMinRow[iR];yi<=vMaxRow[iR];yi++)
+            vRowStart[yi+1]++;
     }
 
+    for(int yi=0; yi<nRows; yi++)
+        vRowStart[yi+1] += vRowStart[yi];
+
+    vector<int> vRowIndices(vRowStart[nRows]);
+    vector<int> vRowFill(vRowStart.begin(),vRowStart.end()-1);
+
+    for(int iR=0; iR<Nr; iR++)
+        for(int yi=vMinRow[iR];yi<=vMaxRow[iR];yi++)
+            vRowIndices[vRowFill[yi]++] = iR;
+
     // Set limits for search
     const float minZ = mb;
     const float minD = 0;
@@ -846,6 +1139,14 @@ void Frame::ComputeStereoMatches()
     vector<pair<int, int> > vDistIdx;
     vDistIdx.reserve(N);
 
+    vector<int> vCandidates;
+    vector<int> vDistances;
+
+    // Sliding window search
+    const int w = 5;
+    const int L = 5;
+    int vDists[2*L+1];
+
     for(int iL=0; iL<N; iL++)
     {
         const cv::KeyPoint &kpL = mvKeys[iL];
@@ -853,9 +1154,8 @@ void Frame::ComputeStereoMatches()
         const float &vL = kpL.pt.y;
         const float &uL = kpL.pt.x;
 
-        const vector<size_t> &vCandidates = vRowIndices[vL];
-
-        if(vCandidates.empty())
+        const int rowL = vL;
+        if(vRowStart[rowL]==vRowStart[rowL+1])
             continue;
 
         const float minU = uL-maxD;
@@ -864,15 +1164,11 @@ void Frame::ComputeStereoMatches()
         if(maxU<0)
             continue;
 
-        int bestDist = ORBmatcher::TH_HIGH;
-        size_t bestIdxR = 0;
-
-        const cv::Mat &dL = mDescriptors.row(iL);
-
-        // Compare descriptor to right keypoints
-        for(size_t iC=0; iC<vCandidates.size(); iC++)
+        // Right keypoints of the row in the disparity range and in the neighbour scales
+        vCandidates.clear();
+        for(int iC=vRowStart[rowL]; iC<vRowStart[rowL+1]; iC++)
         {
-            const size_t iR = vCandidates[iC];
+            const int iR = vRowIndices[iC];
             const cv::KeyPoint &kpR = mvKeysRight[iR];
 
             if(kpR.octave<levelL-1 || kpR.octave>levelL+1)
@@ -881,15 +1177,22 @@ void Frame::ComputeStereoMatches()
             const float &uR = kpR.pt.x;
 
             if(uR>=minU && uR<=maxU)
-            {
-                const cv::Mat &dR = mDescriptorsRight.row(iR);
-                const int dist = ORBmatcher::DescriptorDistance(dL,dR);
+                vCandidates.push_back(iR);
+        }
 
-                if(dist<bestDist)
-                {
-                    bestDist = dist;
-                    bestIdxR = iR;
-                }
+        vDistances.resize(vCandidates.size());
+        ORBmatcher::DescriptorDistances(mDescriptors.ptr(iL),mDescriptorsRight,vCandidates.data(),vCandidates.size(),vDistances.data());
+
+        int bestDist = ORBmatcher::TH_HIGH;
+        size_t bestIdxR = 0;
+
+        // Compare descriptor to right keypoints
+        for(size_t iC=0; iC<vCandidates.size(); iC++)
+        {
+            if(vDistances[iC]<bestDist)
+            {
+                bestDist = vDistances[iC];
+                bestIdxR = vCandidates[iC];
             }
         }
 
@@ -903,33 +1206,29 @@ void Frame::ComputeStereoMatches()
             const float scaledvL = round(kpL.pt.y*scaleFactor);
             const float scaleduR0 = round(uR0*scaleFactor);
 
-            // sliding window search
-            const int w = 5;
-            cv::Mat IL = mpORBextractorLeft->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduL-w,scaleduL+w+1);
-
-            int bestDist = INT_MAX;
-            int bestincR = 0;
-            const int L = 5;
-            vector<float> vDists;
-            vDists.resize(2*L+1);
+            const cv::Mat &imL = mpORBextractorLeft->mvImagePyramid[kpL.octave];
+            const cv::Mat &imR = mpORBextractorRight->mvImagePyramid[kpL.octave];
 
             const float iniu = scaleduR0+L-w;
             const float endu = scaleduR0+L+w+1;
-            if(iniu<0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols)
+            if(iniu<0 || endu >= imR.cols)
                 continue;
 
+            // The pyramid levels are views into buffers with a border of EDGE_THRESHOLD pixels,
+            // so the windows can be read past their right end
+            const uchar* pL = imL.ptr<uchar>((int)scaledvL-w) + (int)scaleduL-w;
+            const uchar* pR = imR.ptr<uchar>((int)scaledvL-w) + (int)scaleduR0-L-w;
+            SlidingWindowSAD(pL,imL.step,pR,imR.step,w,2*L+1,vDists);
+
+            int bestDist = INT_MAX;
+            int bestincR = 0;
             for(int incR=-L; incR<=+L; incR++)
             {
-                cv::Mat IR = mpORBextractorRight->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduR0+incR-w,scaleduR0+incR+w+1);
-
-                float dist = cv::norm(IL,IR,cv::NORM_L1);
-                if(dist<bestDist)
+                if(vDists[L+incR]<bestDist)
                 {
-                    bestDist =  dist;
+                    bestDist = vDists[L+incR];
                     bestincR = incR;
                 }
-
-                vDists[L+incR] = dist;
             }
 
             if(bestincR==-L || bestincR==L)
@@ -957,8 +1256,8 @@ void Frame::ComputeStereoMatches()
                     disparity=0.01;
                     bestuR = uL-0.01;
                 }
-                mvDepth[iL]=mbf/disparity;
-                mvuRight[iL] = bestuR;
+                vDepth[iL]=mbf/disparity;
+                vuRight[iL] = bestuR;
                 vDistIdx.push_back(pair<int,int>(bestDist,iL));
             }
         }
@@ -974,8 +1273,8 @@ void Frame::ComputeStereoMatches()
             break;
         else
         {
-            mvuRight[vDistIdx[i].second]=-1;
-            mvDepth[vDistIdx[i].second]=-1;
+            vuRight[vDistIdx[i].second]=-1;
+            vDepth[vDistIdx[i].second]=-1;
         }
     }
 }
@@ -985,6 +1284,8 @@ void Frame::ComputeStereoFromRGBD(const cv::Mat &imDepth)
 {
     mvuRight = vector<float>(N,-1);
     mvDepth = vector<float>(N,-1);
+    vector<float> &vuRight = mvuRight.Edit();
+    vector<float> &vDepth = mvDepth.Edit();
 
     for(int i=0; i<N; i++)
     {
@@ -998,8 +1299,8 @@ void Frame::ComputeStereoFromRGBD(const cv::Mat &imDepth)
 
         if(d>0)
         {
-            mvDepth[i] = d;
-            mvuRight[i] = kpU.pt.x-mbf/d;
+            vDepth[i] = d;
+            vuRight[i] = kpU.pt.x-mbf/d;
         }
     }
 }
@@ -1056,10 +1357,8 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[1]);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight,static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[1]);
-    threadLeft.join();
-    threadRight.join();
+    ExtractORBStereo(imLeft,imRight,static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[1],
+                     static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[1]);
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndExtORB = std::chrono::steady_clock::now();
 
@@ -1124,44 +1423,137 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 }
 
 void Frame::ComputeStereoFishEyeMatches() {
-    //Speed it up by matching keypoints in the lapping area
-    vector<cv::KeyPoint> stereoLeft(mvKeys.begin() + monoLeft, mvKeys.end());
-    vector<cv::KeyPoint> stereoRight(mvKeysRight.begin() + monoRight, mvKeysRight.end());
-
-    cv::Mat stereoDescLeft = mDescriptors.rowRange(monoLeft, mDescriptors.rows);
-    cv::Mat stereoDescRight = mDescriptorsRight.rowRange(monoRight, mDescriptorsRight.rows);
-
     mvLeftToRightMatch = vector<int>(Nleft,-1);
     mvRightToLeftMatch = vector<int>(Nright,-1);
     mvDepth = vector<float>(Nleft,-1.0f);
     mvuRight = vector<float>(Nleft,-1);
+    vector<float> &vDepth = mvDepth.Edit();
     mvStereo3Dpoints = vector<Eigen::Vector3f>(Nleft);
     mnCloseMPs = 0;
 
-    //Perform a brute force between Keypoint in the left and right image
-    vector<vector<cv::DMatch>> matches;
+    if(monoLeft>=Nleft || monoRight>=Nright)
+        return;
+
+    // Every epipolar plane contains the baseline, so it is given by its angle around the baseline.
+    // A left ray and a right ray can only match if they have the same angle.
+    const Eigen::Vector3f u = mtlr.normalized();
+    const Eigen::Vector3f a = fabs(u(1))<0.9f ? Eigen::Vector3f::UnitY() : Eigen::Vector3f::UnitX();
+    const Eigen::Vector3f e1 = u.cross(a).normalized();
+    const Eigen::Vector3f e2 = u.cross(e1);
+
+    // Pixel distance to the epipolar curve accepted at level 0, converted to an angle with the focal length
+    const float thEpipolar = 3.0f;
+    const float thAngle = thEpipolar/mpCamera->getParameter(0);
+    const float maxScale = mvScaleFactors.back();
+
+    // Index the keypoints of the lapping area of the right image by epipolar plane, one row
+    // of the index per band of angles
+    const int nRight = Nright-monoRight;
+    const int nRows = max(1,min(1024,(int)(2*M_PI/thAngle)));
+    const float rowsPerRad = nRows/(2*M_PI);
+
+    vector<Eigen::Vector3f> vRaysRight(nRight);
+    mpCamera2->unprojectBatch(mvKeysRight.get().data()+monoRight,nRight,vRaysRight.data());
+
+    vector<float> vAngleRight(nRight);
+    vector<int> vRowRight(nRight);
+    vector<int> vRowStart(nRows+1,0);
+    for(int iR=0; iR<nRight; iR++)
+    {
+        const Eigen::Vector3f ray = mRlr*vRaysRight[iR];
+        vAngleRight[iR] = atan2(ray.dot(e2),ray.dot(e1));
+        vRowRight[iR] = min(nRows-1,(int)((vAngleRight[iR]+M_PI)*rowsPerRad));
+        vRowStart[vRowRight[iR]+1]++;
+    }
+    for(int r=0; r<nRows; r++)
+        vRowStart[r+1] += vRowStart[r];
+
+    vector<int> vRowKeys(nRight);
+    vector<int> vRowFill(vRowStart.begin(),vRowStart.end()-1);
+    for(int iR=0; iR<nRight; iR++)
+        vRowKeys[vRowFill[vRowRight[iR]]++] = iR+monoRight;
+
+    const int thOrbDist = (ORBmatcher::TH_HIGH+ORBmatcher::TH_LOW)/2;
+
+    vector<int> vCandidates;
+    vector<int> vDistances;
 
-    BFmatcher.knnMatch(stereoDescLeft,stereoDescRight,matches,2);
+    vector<Eigen::Vector3f> vRaysLeft(Nleft-monoLeft);
+    mpCamera->unprojectBatch(mvKeys.get().data()+monoLeft,Nleft-monoLeft,vRaysLeft.data());
 
     int nMatches = 0;
-    int descMatches = 0;
-
-    //Check matches using Lowe's ratio
-    for(vector<vector<cv::DMatch>>::iterator it = matches.begin(); it != matches.end(); ++it){
-        if((*it).size() >= 2 && (*it)[0].distance < (*it)[1].distance * 0.7){
-            //For every good match, check parallax and reprojection error to discard spurious matches
-            Eigen::Vector3f p3D;
-            descMatches++;
-            float sigma1 = mvLevelSigma2[mvKeys[(*it)[0].queryIdx + monoLeft].octave], sigma2 = mvLevelSigma2[mvKeysRight[(*it)[0].trainIdx + monoRight].octave];
-            float depth = static_cast<KannalaBrandt8*>(mpCamera)->TriangulateMatches(mpCamera2,mvKeys[(*it)[0].queryIdx + monoLeft],mvKeysRight[(*it)[0].trainIdx + monoRight],mRlr,mtlr,sigma1,sigma2,p3D);
-            if(depth > 0.0001f){
-                mvLeftToRightMatch[(*it)[0].queryIdx + monoLeft] = (*it)[0].trainIdx + monoRight;
-                mvRightToLeftMatch[(*it)[0].trainIdx + monoRight] = (*it)[0].queryIdx + monoLeft;
-                mvStereo3Dpoints[(*it)[0].queryIdx + monoLeft] = p3D;
-                mvDepth[(*it)[0].queryIdx + monoLeft] = depth;
-                nMatches++;
+
+    for(int iL=monoLeft; iL<Nleft; iL++)
+    {
+        const cv::KeyPoint &kpL = mvKeys[iL];
+        const Eigen::Vector3f &ray = vRaysLeft[iL-monoLeft];
+        const float angleL = atan2(ray.dot(e2),ray.dot(e1));
+
+        // The angle around the baseline is less accurate for rays close to it
+        const float sinBaseline = ray.cross(u).norm()/ray.norm();
+        const float thL = thAngle*mvScaleFactors[kpL.octave]/max(sinBaseline,1e-3f);
+        const float thMax = thL + thAngle*maxScale/max(sinBaseline,1e-3f);
+
+        // Rows of the band around the epipolar curve, wrapping around -pi/pi
+        const int firstRow = (int)floor((angleL-thMax+M_PI)*rowsPerRad);
+        const int lastRow = (int)floor((angleL+thMax+M_PI)*rowsPerRad);
+        const int nBandRows = min(nRows,lastRow-firstRow+1);
+
+        vCandidates.clear();
+        for(int k=0; k<nBandRows; k++)
+        {
+            const int r = ((firstRow+k)%nRows+nRows)%nRows;
+            for(int j=vRowStart[r]; j<vRowStart[r+1]; j++)
+            {
+                const int iR = vRowKeys[j];
+
+                float dAngle = fabs(vAngleRight[iR-monoRight]-angleL);
+                if(dAngle>M_PI)
+                    dAngle = 2*M_PI-dAngle;
+
+                if(dAngle>thL + thAngle*mvScaleFactors[mvKeysRight[iR].octave]/max(sinBaseline,1e-3f))
+                    continue;
+
+                vCandidates.push_back(iR);
             }
         }
+
+        if(vCandidates.empty())
+            continue;
+
+        vDistances.resize(vCandidates.size());
+        ORBmatcher::DescriptorDistances(mDescriptors.ptr(iL),mDescriptorsRight,vCandidates.data(),vCandidates.size(),vDistances.data());
+
+        int bestDist = 256;
+        int bestDist2 = 256;
+        int bestIdxR = -1;
+        for(size_t k=0; k<vCandidates.size(); k++)
+        {
+            if(vDistances[k]<bestDist)
+            {
+                bestDist2 = bestDist;
+                bestDist = vDistances[k];
+                bestIdxR = vCandidates[k];
+            }
+            else if(vDistances[k]<bestDist2)
+                bestDist2 = vDistances[k];
+        }
+
+        //Check matches using Lowe's ratio
+        if(bestDist>=thOrbDist || bestDist>=bestDist2*0.7)
+            continue;
+
+        //For every good match, check parallax and reprojection error to discard spurious matches
+        Eigen::Vector3f p3D;
+        float sigma1 = mvLevelSigma2[kpL.octave], sigma2 = mvLevelSigma2[mvKeysRight[bestIdxR].octave];
+        float depth = static_cast<KannalaBrandt8*>(mpCamera)->TriangulateMatches(mpCamera2,kpL,mvKeysRight[bestIdxR],mRlr,mtlr,sigma1,sigma2,p3D);
+        if(depth > 0.0001f){
+            mvLeftToRightMatch[iL] = bestIdxR;
+            mvRightToLeftMatch[bestIdxR] = iL;
+            mvStereo3Dpoints[iL] = p3D;
+            vDepth[iL] = depth;
+            nMatches++;
+        }
     }
 }
 
@@ -19,6 +19,7 @@
 #include "G2oTypes.h"
 #include "ImuTypes.h"
 #include "Converter.h"
+#include "CameraModel.h"
 namespace ORB_SLAM3
 {
 
@@ -171,7 +172,7 @@ Eigen::Vector2d ImuCamPose::Project(const Eigen::Vector3d &Xw, int cam_idx) cons
 {
     Eigen::Vector3d Xc = Rcw[cam_idx] * Xw + tcw[cam_idx];
 
-    return pCamera[cam_idx]->project(Xc);
+    return ProjectPoint(pCamera[cam_idx],Xc);
 }
 
 Eigen::Vector3d ImuCamPose::ProjectStereo(const Eigen::Vector3d &Xw, int cam_idx) const
@@ -179,7 +180,7 @@ Eigen::Vector3d ImuCamPose::ProjectStereo(const Eigen::Vector3d &Xw, int cam_idx
     Eigen::Vector3d Pc = Rcw[cam_idx] * Xw + tcw[cam_idx];
     Eigen::Vector3d pc;
     double invZ = 1/Pc(2);
-    pc.head(2) = pCamera[cam_idx]->project(Pc);
+    pc.head(2) = ProjectPoint(pCamera[cam_idx],Pc);
     pc(2) = pc(0) - bf*invZ;
     return pc;
 }
@@ -357,7 +358,7 @@ void EdgeMono::linearizeOplus()
     const Eigen::Vector3d Xb = VPose->estimate().Rbc[cam_idx]*Xc+VPose->estimate().tbc[cam_idx];
     const Eigen::Matrix3d &Rcb = VPose->estimate().Rcb[cam_idx];
 
-    const Eigen::Matrix<double,2,3> proj_jac = VPose->estimate().pCamera[cam_idx]->projectJac(Xc);
+    const Eigen::Matrix<double,2,3> proj_jac = ProjectJac(VPose->estimate().pCamera[cam_idx],Xc);
     _jacobianOplusXi = -proj_jac * Rcw;
 
     Eigen::Matrix<double,3,6> SE3deriv;
@@ -382,7 +383,7 @@ void EdgeMonoOnlyPose::linearizeOplus()
     const Eigen::Vector3d Xb = VPose->estimate().Rbc[cam_idx]*Xc+VPose->estimate().tbc[cam_idx];
     const Eigen::Matrix3d &Rcb = VPose->estimate().Rcb[cam_idx];
 
-    Eigen::Matrix<double,2,3> proj_jac = VPose->estimate().pCamera[cam_idx]->projectJac(Xc);
+    Eigen::Matrix<double,2,3> proj_jac = ProjectJac(VPose->estimate().pCamera[cam_idx],Xc);
 
     Eigen::Matrix<double,3,6> SE3deriv;
     double x = Xb(0);
@@ -408,7 +409,7 @@ void EdgeStereo::linearizeOplus()
     const double inv_z2 = 1.0/(Xc(2)*Xc(2));
 
     Eigen::Matrix<double,3,3> proj_jac;
-    proj_jac.block<2,3>(0,0) = VPose->estimate().pCamera[cam_idx]->projectJac(Xc);
+    proj_jac.block<2,3>(0,0) = ProjectJac(VPose->estimate().pCamera[cam_idx],Xc);
     proj_jac.block<1,3>(2,0) = proj_jac.block<1,3>(0,0);
     proj_jac(2,2) += bf*inv_z2;
 
@@ -439,7 +440,7 @@ void EdgeStereoOnlyPose::linearizeOplus()
     const double inv_z2 = 1.0/(Xc(2)*Xc(2));
 
     Eigen::Matrix<double,3,3> proj_jac;
-    proj_jac.block<2,3>(0,0) = VPose->estimate().pCamera[cam_idx]->projectJac(Xc);
+    proj_jac.block<2,3>(0,0) = ProjectJac(VPose->estimate().pCamera[cam_idx],Xc);
     proj_jac.block<1,3>(2,0) = proj_jac.block<1,3>(0,0);
     proj_jac(2,2) += bf*inv_z2;
 
@@ -19,12 +19,15 @@
 #include "KeyFrame.h"
 #include "Converter.h"
 #include "ImuTypes.h"
+#include "EpochManager.h"
 #include<mutex>
+#include<limits>
 
 namespace ORB_SLAM3
 {
 
 long unsigned int KeyFrame::nNextId=0;
+EpochManager* KeyFrame::mpEpochManager = NULL;
 
 KeyFrame::KeyFrame():
         mnFrameId(0),  mTimeStamp(0), mnGridCols(FRAME_GRID_COLS), mnGridRows(FRAME_GRID_ROWS),
@@ -49,7 +52,7 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     mnLoopQuery(0), mnLoopWords(0), mnRelocQuery(0), mnRelocWords(0), mnBAGlobalForKF(0), mnPlaceRecognitionQuery(0), mnPlaceRecognitionWords(0), mPlaceRecognitionScore(0),
     fx(F.fx), fy(F.fy), cx(F.cx), cy(F.cy), invfx(F.invfx), invfy(F.invfy),
     mbf(F.mbf), mb(F.mb), mThDepth(F.mThDepth), N(F.N), mvKeys(F.mvKeys), mvKeysUn(F.mvKeysUn),
-    mvuRight(F.mvuRight), mvDepth(F.mvDepth), mDescriptors(F.mDescriptors.clone()),
+    mvuRight(F.mvuRight), mvDepth(F.mvDepth), mDescriptors(F.mDescriptors),
     mBowVec(F.mBowVec), mFeatVec(F.mFeatVec), mnScaleLevels(F.mnScaleLevels), mfScaleFactor(F.mfScaleFactor),
     mfLogScaleFactor(F.mfLogScaleFactor), mvScaleFactors(F.mvScaleFactors), mvLevelSigma2(F.mvLevelSigma2),
     mvInvLevelSigma2(F.mvInvLevelSigma2), mnMinX(F.mnMinX), mnMinY(F.mnMinY), mnMaxX(F.mnMaxX),
@@ -59,24 +62,11 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     mbToBeErased(false), mbBad(false), mHalfBaseline(F.mb/2), mpMap(pMap), mbCurrentPlaceRecognition(false), mNameFile(F.mNameFile), mnMergeCorrectedForKF(0),
     mpCamera(F.mpCamera), mpCamera2(F.mpCamera2),
     mvLeftToRightMatch(F.mvLeftToRightMatch),mvRightToLeftMatch(F.mvRightToLeftMatch), mTlr(F.GetRelativePoseTlr()),
-    mvKeysRight(F.mvKeysRight), NLeft(F.Nleft), NRight(F.Nright), mTrl(F.GetRelativePoseTrl()), mnNumberOfOpt(0), mbHasVelocity(false)
+    mvKeysRight(F.mvKeysRight), NLeft(F.Nleft), NRight(F.Nright), mTrl(F.GetRelativePoseTrl()), mnNumberOfOpt(0), mbHasVelocity(false),
+    mGrid(F.mGrid), mGridRight(F.mGridRight)
 {
     mnId=nNextId++;
 
-    mGrid.resize(mnGridCols);
-    if(F.Nleft != -1)  mGridRight.resize(mnGridCols);
-    for(int i=0; i<mnGridCols;i++)
-    {
-        mGrid[i].resize(mnGridRows);
-        if(F.Nleft != -1) mGridRight[i].resize(mnGridRows);
-        for(int j=0; j<mnGridRows; j++){
-            mGrid[i][j] = F.mGrid[i][j];
-            if(F.Nleft != -1){
-                mGridRight[i][j] = F.mGridRight[i][j];
-            }
-        }
-    }
-
 
 
     if(!F.HasVelocity()) {
@@ -119,6 +109,16 @@ void KeyFrame::SetPose(const Sophus::SE3f &Tcw)
     {
         mOwb = mRwc * mImuCalib.mTcb.translation() + mTwc.translation();
     }
+
+    float pose[POSE_SIZE];
+    std::copy(mTcw.data(),mTcw.data()+7,pose+POSE_TCW);
+    std::copy(mTwc.data(),mTwc.data()+7,pose+POSE_TWC);
+    Eigen::Map<Eigen::Matrix3f>(pose+POSE_RCW) = mRcw;
+    if(mImuCalib.mbIsSet)
+        Eigen::Map<Eigen::Vector3f>(pose+POSE_OWB) = mOwb;
+    else
+        Eigen::Map<Eigen::Vector3f>(pose+POSE_OWB).setZero();
+    mPoseSeq.Write(pose);
 }
 
 void KeyFrame::SetVelocity(const Eigen::Vector3f &Vw)
@@ -130,25 +130,35 @@ void KeyFrame::SetVelocity(const Eigen::Vector3f &Vw)
 
 Sophus::SE3f KeyFrame::GetPose()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return mTcw;
+    Sophus::SE3f Tcw;
+    mPoseSeq.Read(Tcw.data(),POSE_TCW,7);
+    return Tcw;
 }
 
 Sophus::SE3f KeyFrame::GetPoseInverse()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return mTwc;
+    Sophus::SE3f Twc;
+    mPoseSeq.Read(Twc.data(),POSE_TWC,7);
+    return Twc;
 }
 
 Eigen::Vector3f KeyFrame::GetCameraCenter(){
-    unique_lock<mutex> lock(mMutexPose);
-    return mTwc.translation();
+    // Translation of Twc, after its quaternion
+    Eigen::Vector3f Ow;
+    mPoseSeq.Read(Ow.data(),POSE_TWC+4,3);
+    return Ow;
+}
+
+unsigned int KeyFrame::GetPoseVersion()
+{
+    return mPoseSeq.Version();
 }
 
 Eigen::Vector3f KeyFrame::GetImuPosition()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return mOwb;
+    Eigen::Vector3f Owb;
+    mPoseSeq.Read(Owb.data(),POSE_OWB,3);
+    return Owb;
 }
 
 Eigen::Matrix3f KeyFrame::GetImuRotation()
@@ -164,14 +174,16 @@ Sophus::SE3f KeyFrame::GetImuPose()
 }
 
 Eigen::Matrix3f KeyFrame::GetRotation(){
-    unique_lock<mutex> lock(mMutexPose);
-    return mRcw;
+    Eigen::Matrix3f Rcw;
+    mPoseSeq.Read(Rcw.data(),POSE_RCW,9);
+    return Rcw;
 }
 
 Eigen::Vector3f KeyFrame::GetTranslation()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return mTcw.translation();
+    Eigen::Vector3f tcw;
+    mPoseSeq.Read(tcw.data(),POSE_TCW+4,3);
+    return tcw;
 }
 
 Eigen::Vector3f KeyFrame::GetVelocity()
@@ -188,41 +200,42 @@ bool KeyFrame::isVelocitySet()
 
 void KeyFrame::AddConnection(KeyFrame *pKF, const int &weight)
 {
+    const bool bBad = pKF->isBad();
+
+    unique_lock<mutex> lock(mMutexConnections);
+    map<KeyFrame*,int>::iterator mit = mConnectedKeyFrameWeights.find(pKF);
+    if(mit!=mConnectedKeyFrameWeights.end())
     {
-        unique_lock<mutex> lock(mMutexConnections);
-        if(!mConnectedKeyFrameWeights.count(pKF))
-            mConnectedKeyFrameWeights[pKF]=weight;
-        else if(mConnectedKeyFrameWeights[pKF]!=weight)
-            mConnectedKeyFrameWeights[pKF]=weight;
-        else
+        if(mit->second==weight)
             return;
+        msOrderedConnections.erase(make_pair(mit->second,pKF));
+        mit->second = weight;
     }
+    else
+        mConnectedKeyFrameWeights[pKF]=weight;
 
-    UpdateBestCovisibles();
+    if(!bBad)
+        msOrderedConnections.insert(make_pair(weight,pKF));
 }
 
 void KeyFrame::UpdateBestCovisibles()
 {
     unique_lock<mutex> lock(mMutexConnections);
-    vector<pair<int,KeyFrame*> > vPairs;
-    vPairs.reserve(mConnectedKeyFrameWeights.size());
+    msOrderedConnections.clear();
     for(map<KeyFrame*,int>::iterator mit=mConnectedKeyFrameWeights.begin(), mend=mConnectedKeyFrameWeights.end(); mit!=mend; mit++)
-       vPairs.push_back(make_pair(mit->second,mit->first));
-
-    sort(vPairs.begin(),vPairs.end());
-    list<KeyFrame*> lKFs;
-    list<int> lWs;
-    for(size_t i=0, iend=vPairs.size(); i<iend;i++)
     {
-        if(!vPairs[i].second->isBad())
-        {
-            lKFs.push_front(vPairs[i].second);
-            lWs.push_front(vPairs[i].first);
-        }
+        if(!mit->first->isBad())
+            msOrderedConnections.insert(make_pair(mit->second,mit->first));
     }
+}
 
-    mvpOrderedConnectedKeyFrames = vector<KeyFrame*>(lKFs.begin(),lKFs.end());
-    mvOrderedWeights = vector<int>(lWs.begin(), lWs.end());
+void KeyFrame::UpdateCovisibility(KeyFrame* pKF, const int nDelta)
+{
+    unique_lock<mutex> lock(mMutexCovisibility);
+    map<KeyFrame*,int>::iterator mit = mCovisibilityCounter.insert(make_pair(pKF,0)).first;
+    mit->second += nDelta;
+    if(mit->second==0)
+        mCovisibilityCounter.erase(mit);
 }
 
 set<KeyFrame*> KeyFrame::GetConnectedKeyFrames()
@@ -234,42 +247,49 @@ set<KeyFrame*> KeyFrame::GetConnectedKeyFrames()
     return s;
 }
 
+void KeyFrame::GetGoodConnections(const int N, const int w, vector<KeyFrame*> &vpKFs)
+{
+    vpKFs.clear();
+    {
+        unique_lock<mutex> lock(mMutexConnections);
+        for(auto sit=msOrderedConnections.begin(), send=msOrderedConnections.end(); sit!=send && sit->first>=w; sit++)
+            vpKFs.push_back(sit->second);
+    }
+
+    // Outside mMutexConnections, isBad locks the other keyframe
+    size_t nGood = 0;
+    for(size_t i=0; i<vpKFs.size() && (int)nGood<N; i++)
+    {
+        if(!vpKFs[i]->isBad())
+            vpKFs[nGood++] = vpKFs[i];
+    }
+    vpKFs.resize(nGood);
+}
+
 vector<KeyFrame*> KeyFrame::GetVectorCovisibleKeyFrames()
 {
-    unique_lock<mutex> lock(mMutexConnections);
-    return mvpOrderedConnectedKeyFrames;
+    vector<KeyFrame*> vpKFs;
+    GetGoodConnections(numeric_limits<int>::max(),0,vpKFs);
+    return vpKFs;
 }
 
 vector<KeyFrame*> KeyFrame::GetBestCovisibilityKeyFrames(const int &N)
 {
-    unique_lock<mutex> lock(mMutexConnections);
-    if((int)mvpOrderedConnectedKeyFrames.size()<N)
-        return mvpOrderedConnectedKeyFrames;
-    else
-        return vector<KeyFrame*>(mvpOrderedConnectedKeyFrames.begin(),mvpOrderedConnectedKeyFrames.begin()+N);
+    vector<KeyFrame*> vpKFs;
+    GetGoodConnections(N,0,vpKFs);
+    return vpKFs;
+}
 
+void KeyFrame::GetBestCovisibilityKeyFrames(const int &N, vector<KeyFrame*> &vpKFs)
+{
+    GetGoodConnections(N,0,vpKFs);
 }
 
 vector<KeyFrame*> KeyFrame::GetCovisiblesByWeight(const int &w)
 {
-    unique_lock<mutex> lock(mMutexConnections);
-
-    if(mvpOrderedConnectedKeyFrames.empty())
-    {
-        return vector<KeyFrame*>();
-    }
-
-    vector<int>::iterator it = upper_bound(mvOrderedWeights.begin(),mvOrderedWeights.end(),w,KeyFrame::weightComp);
-
-    if(it==mvOrderedWeights.end() && mvOrderedWeights.back() < w)
-    {
-        return vector<KeyFrame*>();
-    }
-    else
-    {
-        int n = it-mvOrderedWeights.begin();
-        return vector<KeyFrame*>(mvpOrderedConnectedKeyFrames.begin(), mvpOrderedConnectedKeyFrames.begin()+n);
-    }
+    vector<KeyFrame*> vpKFs;
+    GetGoodConnections(numeric_limits<int>::max(),w,vpKFs);
+    return vpKFs;
 }
 
 int KeyFrame::GetWeight(KeyFrame *pKF)
@@ -306,6 +326,16 @@ void KeyFrame::EraseMapPointMatch(const int &idx)
     mvpMapPoints[idx]=static_cast<MapPoint*>(NULL);
 }
 
+void KeyFrame::EraseMapPointMatches(const std::unordered_set<MapPoint*> &spMPs)
+{
+    unique_lock<mutex> lock(mMutexFeatures);
+    for(size_t i=0; i<mvpMapPoints.size(); i++)
+    {
+        if(mvpMapPoints[i] && spMPs.count(mvpMapPoints[i]))
+            mvpMapPoints[i]=static_cast<MapPoint*>(NULL);
+    }
+}
+
 void KeyFrame::EraseMapPointMatch(MapPoint* pMP)
 {
     tuple<size_t,size_t> indexes = pMP->GetIndexInKeyFrame(this);
@@ -378,36 +408,19 @@ MapPoint* KeyFrame::GetMapPoint(const size_t &idx)
 
 void KeyFrame::UpdateConnections(bool upParent)
 {
+    // The map points keep the number of shared points up to date when observations are added or erased
     map<KeyFrame*,int> KFcounter;
-
-    vector<MapPoint*> vpMP;
-
     {
-        unique_lock<mutex> lockMPs(mMutexFeatures);
-        vpMP = mvpMapPoints;
+        unique_lock<mutex> lockCovis(mMutexCovisibility);
+        KFcounter = mCovisibilityCounter;
     }
 
-    //For all map points in keyframe check in which other keyframes are they seen
-    //Increase counter for those keyframes
-    for(vector<MapPoint*>::iterator vit=vpMP.begin(), vend=vpMP.end(); vit!=vend; vit++)
+    for(map<KeyFrame*,int>::iterator mit=KFcounter.begin(); mit!=KFcounter.end();)
     {
-        MapPoint* pMP = *vit;
-
-        if(!pMP)
-            continue;
-
-        if(pMP->isBad())
-            continue;
-
-        map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
-
-        for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
-        {
-            if(mit->first->mnId==mnId || mit->first->isBad() || mit->first->GetMap() != mpMap)
-                continue;
-            KFcounter[mit->first]++;
-
-        }
+        if(mit->second<=0 || mit->first->isBad() || mit->first->GetMap() != mpMap)
+            mit = KFcounter.erase(mit);
+        else
+            mit++;
     }
 
     // This should not happen
@@ -446,26 +459,17 @@ void KeyFrame::UpdateConnections(bool upParent)
         pKFmax->AddConnection(this,nmax);
     }
 
-    sort(vPairs.begin(),vPairs.end());
-    list<KeyFrame*> lKFs;
-    list<int> lWs;
-    for(size_t i=0; i<vPairs.size();i++)
-    {
-        lKFs.push_front(vPairs[i].second);
-        lWs.push_front(vPairs[i].first);
-    }
-
     {
         unique_lock<mutex> lockCon(mMutexConnections);
 
         mConnectedKeyFrameWeights = KFcounter;
-        mvpOrderedConnectedKeyFrames = vector<KeyFrame*>(lKFs.begin(),lKFs.end());
-        mvOrderedWeights = vector<int>(lWs.begin(), lWs.end());
+        msOrderedConnections.clear();
+        msOrderedConnections.insert(vPairs.begin(),vPairs.end());
 
 
         if(mbFirstConnection && mnId!=mpMap->GetInitKFid())
         {
-            mpParent = mvpOrderedConnectedKeyFrames.front();
+            mpParent = msOrderedConnections.begin()->second;
             mpParent->AddChild(this);
             mbFirstConnection = false;
         }
@@ -504,6 +508,13 @@ set<KeyFrame*> KeyFrame::GetChilds()
     return mspChildrens;
 }
 
+void KeyFrame::GetChilds(vector<KeyFrame*> &vpChilds)
+{
+    vpChilds.clear();
+    unique_lock<mutex> lockCon(mMutexConnections);
+    vpChilds.insert(vpChilds.end(),mspChildrens.begin(),mspChildrens.end());
+}
+
 KeyFrame* KeyFrame::GetParent()
 {
     unique_lock<mutex> lockCon(mMutexConnections);
@@ -572,6 +583,7 @@ void KeyFrame::SetErase()
 
 void KeyFrame::SetBadFlag()
 {
+    bool bWasBad;
     {
         unique_lock<mutex> lock(mMutexConnections);
         if(mnId==mpMap->GetInitKFid())
@@ -585,9 +597,22 @@ void KeyFrame::SetBadFlag()
         }
     }
 
-    for(map<KeyFrame*,int>::iterator mit = mConnectedKeyFrameWeights.begin(), mend=mConnectedKeyFrameWeights.end(); mit!=mend; mit++)
+    // Keyframes sharing points with this one may keep it in their connections even if this one dropped them
+    set<KeyFrame*> spConnectedKFs;
     {
-        mit->first->EraseConnection(this);
+        unique_lock<mutex> lock(mMutexConnections);
+        for(map<KeyFrame*,int>::iterator mit = mConnectedKeyFrameWeights.begin(), mend=mConnectedKeyFrameWeights.end(); mit!=mend; mit++)
+            spConnectedKFs.insert(mit->first);
+    }
+    {
+        unique_lock<mutex> lock(mMutexCovisibility);
+        for(map<KeyFrame*,int>::iterator mit = mCovisibilityCounter.begin(), mend=mCovisibilityCounter.end(); mit!=mend; mit++)
+            spConnectedKFs.insert(mit->first);
+    }
+
+    for(set<KeyFrame*>::iterator sit=spConnectedKFs.begin(), send=spConnectedKFs.end(); sit!=send; sit++)
+    {
+        (*sit)->EraseConnection(this);
     }
 
     for(size_t i=0; i<mvpMapPoints.size(); i++)
@@ -603,7 +628,7 @@ void KeyFrame::SetBadFlag()
         unique_lock<mutex> lock1(mMutexFeatures);
 
         mConnectedKeyFrameWeights.clear();
-        mvpOrderedConnectedKeyFrames.clear();
+        msOrderedConnections.clear();
 
         // Update Spanning Tree
         set<KeyFrame*> sParentCandidates;
@@ -670,12 +695,39 @@ void KeyFrame::SetBadFlag()
             mpParent->EraseChild(this);
             mTcp = mTcw * mpParent->GetPoseInverse();
         }
+        bWasBad = mbBad;
         mbBad = true;
     }
 
 
     mpMap->EraseKeyFrame(this);
     mpKeyFrameDB->erase(this);
+
+    // The features are released once no thread can reach them anymore
+    if(mpEpochManager && !bWasBad)
+        mpEpochManager->Retire(this);
+}
+
+size_t KeyFrame::ReleaseFeatures()
+{
+    unique_lock<mutex> lock(mMutexFeatures);
+
+    // The descriptors may still be shared with a Frame, they are only freed with the last reference
+    size_t nBytes = 0;
+    if(mDescriptors.u && mDescriptors.u->refcount==1)
+        nBytes += mDescriptors.total()*mDescriptors.elemSize();
+    nBytes += mBowVec.size()*(sizeof(DBoW2::WordId)+sizeof(DBoW2::WordValue));
+    for(DBoW2::FeatureVector::const_iterator it=mFeatVec.begin(), itend=mFeatVec.end(); it!=itend; it++)
+        nBytes += sizeof(DBoW2::NodeId) + it->second.size()*sizeof(unsigned int);
+
+    mDescriptors.release();
+    mBowVec.clear();
+    mFeatVec.clear();
+
+    // Keep the size, code indexing the matches with the keypoints still works
+    fill(mvpMapPoints.begin(),mvpMapPoints.end(),static_cast<MapPoint*>(NULL));
+
+    return nBytes;
 }
 
 bool KeyFrame::isBad()
@@ -686,18 +738,13 @@ bool KeyFrame::isBad()
 
 void KeyFrame::EraseConnection(KeyFrame* pKF)
 {
-    bool bUpdate = false;
+    unique_lock<mutex> lock(mMutexConnections);
+    map<KeyFrame*,int>::iterator mit = mConnectedKeyFrameWeights.find(pKF);
+    if(mit!=mConnectedKeyFrameWeights.end())
     {
-        unique_lock<mutex> lock(mMutexConnections);
-        if(mConnectedKeyFrameWeights.count(pKF))
-        {
-            mConnectedKeyFrameWeights.erase(pKF);
-            bUpdate=true;
-        }
+        msOrderedConnections.erase(make_pair(mit->second,pKF));
+        mConnectedKeyFrameWeights.erase(mit);
     }
-
-    if(bUpdate)
-        UpdateBestCovisibles();
 }
 
 
@@ -725,21 +772,24 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
     if(nMaxCellY<0)
         return vIndices;
 
+    const FeatureGrid &grid = (!bRight) ? mGrid : mGridRight;
+    if(grid.empty())
+        return vIndices;
+
     for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
     {
         for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
         {
-            const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
+            for(const int* pIdx=grid.CellBegin(ix,iy), *pEnd=grid.CellEnd(ix,iy); pIdx!=pEnd; pIdx++)
             {
-                const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[vCell[j]]
-                                                         : (!bRight) ? mvKeys[vCell[j]]
-                                                                     : mvKeysRight[vCell[j]];
+                const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[*pIdx]
+                                                         : (!bRight) ? mvKeys[*pIdx]
+                                                                     : mvKeysRight[*pIdx];
                 const float distx = kpUn.pt.x-x;
                 const float disty = kpUn.pt.y-y;
 
                 if(fabs(distx)<r && fabs(disty)<r)
-                    vIndices.push_back(vCell[j]);
+                    vIndices.push_back(*pIdx);
             }
         }
     }
@@ -36,7 +36,8 @@ LoopClosing::LoopClosing(Atlas *pAtlas, KeyFrameDatabase *pDB, ORBVocabulary *pV
     mbResetRequested(false), mbResetActiveMapRequested(false), mbFinishRequested(false), mbFinished(true), mpAtlas(pAtlas),
     mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
     mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0), mnLoopNumCoincidences(0), mnMergeNumCoincidences(0),
-    mbLoopDetected(false), mbMergeDetected(false), mnLoopNumNotFound(0), mnMergeNumNotFound(0), mbActiveLC(bActiveLC)
+    mbLoopDetected(false), mbMergeDetected(false), mnLoopNumNotFound(0), mnMergeNumNotFound(0), mbActiveLC(bActiveLC),
+    mpEpochManager(NULL), mnEpochId(-1)
 {
     mnCovisibilityConsistencyTh = 3;
     mpLastCurrentKF = static_cast<KeyFrame*>(NULL);
@@ -87,6 +88,13 @@ void LoopClosing::SetLocalMapper(LocalMapping *pLocalMapper)
 }
 
 
+void LoopClosing::SetEpochManager(EpochManager* pEpochManager)
+{
+    mpEpochManager=pEpochManager;
+    if(mpEpochManager)
+        mnEpochId = mpEpochManager->Register();
+}
+
 void LoopClosing::Run()
 {
     mbFinished =false;
@@ -302,9 +310,16 @@ void LoopClosing::Run()
             break;
         }
 
+        // The matched points of a loop or merge candidate are kept until it is verified
+        if(mpEpochManager && mnLoopNumCoincidences==0 && mnMergeNumCoincidences==0 && !CheckNewKeyFrames())
+            mpEpochManager->Quiescent(mnEpochId);
+
         usleep(5000);
     }
 
+    if(mpEpochManager)
+        mpEpochManager->Unregister(mnEpochId);
+
     SetFinish();
 }
 
@@ -2077,7 +2092,7 @@ void LoopClosing::CheckObservations(set<KeyFrame*> &spKFsMap1, set<KeyFrame*> &s
                 continue;
             }
 
-            map<KeyFrame*, tuple<int,int>> mMPijObs = pMPij->GetObservations();
+            ObservationList mMPijObs = pMPij->GetObservations();
             for(KeyFrame* pKFi2 : spKFsMap2)
             {
                 if(mMPijObs.find(pKFi2) != mMPijObs.end())
@@ -2269,6 +2284,11 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 {  
     Verbose::PrintMess("Starting Global Bundle Adjustment", Verbose::VERBOSITY_NORMAL);
 
+    // Nothing retired from now on is released until the optimization and the map update are over
+    int nEpochId = -1;
+    if(mpEpochManager)
+        nEpochId = mpEpochManager->Register();
+
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartFGBA = std::chrono::steady_clock::now();
 
@@ -2307,10 +2327,18 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
     {
         unique_lock<mutex> lock(mMutexGBA);
         if(idx!=mnFullBAIdx)
+        {
+            if(mpEpochManager)
+                mpEpochManager->Unregister(nEpochId);
             return;
+        }
 
         if(!bImuInit && pActiveMap->isImuInitialized())
+        {
+            if(mpEpochManager)
+                mpEpochManager->Unregister(nEpochId);
             return;
+        }
 
         if(!mbStopGBA)
         {
@@ -2508,6 +2536,9 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
         mbFinishedGBA = true;
         mbRunningGBA = false;
     }
+
+    if(mpEpochManager)
+        mpEpochManager->Unregister(nEpochId);
 }
 
 void LoopClosing::RequestFinish()
@@ -18,16 +18,20 @@
 
 
 #include "Map.h"
+#include "EpochManager.h"
 
 #include<mutex>
+#include<limits>
 
 namespace ORB_SLAM3
 {
 
 long unsigned int Map::nNextId=0;
+const float Map::POINT_INDEX_VOXEL_SIZE = 0.5f;
 
 Map::Map():mnMaxKFid(0),mnBigChangeIdx(0), mbImuInitialized(false), mnMapChange(0), mpFirstRegionKF(static_cast<KeyFrame*>(NULL)),
-mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false)
+mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false),
+mPointIndex(POINT_INDEX_VOXEL_SIZE)
 {
     mnId=nNextId++;
     mThumbnail = static_cast<GLubyte*>(NULL);
@@ -35,7 +39,8 @@ mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNo
 
 Map::Map(int initKFid):mnInitKFid(initKFid), mnMaxKFid(initKFid),/*mnLastLoopKFid(initKFid),*/ mnBigChangeIdx(0), mIsInUse(false),
                        mHasTumbnail(false), mbBad(false), mbImuInitialized(false), mpFirstRegionKF(static_cast<KeyFrame*>(NULL)),
-                       mnMapChange(0), mbFail(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false)
+                       mnMapChange(0), mbFail(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false),
+                       mPointIndex(POINT_INDEX_VOXEL_SIZE)
 {
     mnId=nNextId++;
     mThumbnail = static_cast<GLubyte*>(NULL);
@@ -75,12 +80,20 @@ void Map::AddKeyFrame(KeyFrame *pKF)
     {
         mpKFlowerID = pKF;
     }
+    lock.unlock();
+
+    // It may hold matches to points culled while it was being created
+    if(KeyFrame::mpEpochManager)
+        KeyFrame::mpEpochManager->AddLinkCandidate(pKF);
 }
 
 void Map::AddMapPoint(MapPoint *pMP)
 {
     unique_lock<mutex> lock(mMutexMap);
     mspMapPoints.insert(pMP);
+
+    unique_lock<mutex> lockIndex(mMutexPointIndex);
+    mPointIndex.insert(pMP,pMP->GetWorldPos());
 }
 
 void Map::SetImuInitialized()
@@ -100,6 +113,9 @@ void Map::EraseMapPoint(MapPoint *pMP)
     unique_lock<mutex> lock(mMutexMap);
     mspMapPoints.erase(pMP);
 
+    unique_lock<mutex> lockIndex(mMutexPointIndex);
+    mPointIndex.erase(pMP);
+
     // TODO: This only erase the pointer.
     // Delete the MapPoint
 }
@@ -107,15 +123,12 @@ void Map::EraseMapPoint(MapPoint *pMP)
 void Map::EraseKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexMap);
-    mspKeyFrames.erase(pKF);
+    if(!mspKeyFrames.erase(pKF))
+        return;
     if(mspKeyFrames.size()>0)
     {
         if(pKF->mnId == mpKFlowerID->mnId)
-        {
-            vector<KeyFrame*> vpKFs = vector<KeyFrame*>(mspKeyFrames.begin(),mspKeyFrames.end());
-            sort(vpKFs.begin(),vpKFs.end(),KeyFrame::lId);
-            mpKFlowerID = vpKFs[0];
-        }
+            mpKFlowerID = *min_element(mspKeyFrames.begin(),mspKeyFrames.end(),KeyFrame::lId);
     }
     else
     {
@@ -126,12 +139,85 @@ void Map::EraseKeyFrame(KeyFrame *pKF)
     // Delete the MapPoint
 }
 
+void Map::UpdateMapPointPosition(MapPoint* pMP, const Eigen::Vector3f &pos)
+{
+    unique_lock<mutex> lock(mMutexPointIndex);
+    mPointIndex.update(pMP,pos);
+}
+
+vector<MapPoint*> Map::GetMapPointsInRadius(const Eigen::Vector3f &pos, const float r)
+{
+    unique_lock<mutex> lock(mMutexPointIndex);
+    return mPointIndex.QueryRadius(pos,r);
+}
+
+vector<MapPoint*> Map::GetMapPointsInFrustum(const Sophus::SE3f &Tcw, GeometricCamera* pCamera, const float minX, const float maxX,
+                                             const float minY, const float maxY, const float maxDepth)
+{
+    // Box around the camera center and the image border at the maximum depth, sampled on each side.
+    // If the field of view is 180 degrees or wider every point is checked
+    const Sophus::SE3f Twc = Tcw.inverse();
+    Eigen::Vector3f minPos = Twc.translation(), maxPos = Twc.translation();
+    bool bBounded = true;
+    const int nSamples = 5;
+    for(int i=0; i<nSamples && bBounded; i++)
+    {
+        const float a = float(i)/(nSamples-1);
+        const cv::Point2f vBorder[4] = {cv::Point2f(minX+a*(maxX-minX),minY), cv::Point2f(minX+a*(maxX-minX),maxY),
+                                        cv::Point2f(minX,minY+a*(maxY-minY)), cv::Point2f(maxX,minY+a*(maxY-minY))};
+        for(int j=0; j<4; j++)
+        {
+            const Eigen::Vector3f ray = pCamera->unprojectEig(vBorder[j]);
+            if(ray(2)<=0.f)
+            {
+                bBounded = false;
+                break;
+            }
+            const Eigen::Vector3f x3Dw = Twc*(ray*(maxDepth/ray(2)));
+            minPos = minPos.cwiseMin(x3Dw);
+            maxPos = maxPos.cwiseMax(x3Dw);
+        }
+    }
+    if(!bBounded)
+    {
+        minPos.setConstant(-numeric_limits<float>::max());
+        maxPos.setConstant(numeric_limits<float>::max());
+    }
+
+    vector<MapPoint*> vpMPs;
+    unique_lock<mutex> lock(mMutexPointIndex);
+    mPointIndex.ForEachInBox(minPos,maxPos,[&](MapPoint* pMP, const Eigen::Vector3f &x3Dw)
+    {
+        const Eigen::Vector3f x3Dc = Tcw*x3Dw;
+        if(x3Dc(2)<=0.f || x3Dc(2)>maxDepth)
+            return;
+        const Eigen::Vector2f uv = pCamera->project(x3Dc);
+        if(uv(0)>=minX && uv(0)<=maxX && uv(1)>=minY && uv(1)<=maxY)
+            vpMPs.push_back(pMP);
+    });
+    return vpMPs;
+}
+
+vector<MapPoint*> Map::GetNearestMapPoints(const Eigen::Vector3f &pos, const int k)
+{
+    unique_lock<mutex> lock(mMutexPointIndex);
+    return mPointIndex.QueryNearest(pos,max(k,0));
+}
+
 void Map::SetReferenceMapPoints(const vector<MapPoint *> &vpMPs)
 {
     unique_lock<mutex> lock(mMutexMap);
     mvpReferenceMapPoints = vpMPs;
 }
 
+void Map::EraseReferenceMapPoints(const std::unordered_set<MapPoint*> &spMPs)
+{
+    unique_lock<mutex> lock(mMutexMap);
+    mvpReferenceMapPoints.erase(remove_if(mvpReferenceMapPoints.begin(),mvpReferenceMapPoints.end(),
+                                          [&spMPs](MapPoint* pMP){return spMPs.count(pMP)>0;}),
+                                mvpReferenceMapPoints.end());
+}
+
 void Map::InformNewBigChange()
 {
     unique_lock<mutex> lock(mMutexMap);
@@ -147,13 +233,25 @@ int Map::GetLastBigChangeIdx()
 vector<KeyFrame*> Map::GetAllKeyFrames()
 {
     unique_lock<mutex> lock(mMutexMap);
-    return vector<KeyFrame*>(mspKeyFrames.begin(),mspKeyFrames.end());
+    return mspKeyFrames.items();
 }
 
 vector<MapPoint*> Map::GetAllMapPoints()
 {
     unique_lock<mutex> lock(mMutexMap);
-    return vector<MapPoint*>(mspMapPoints.begin(),mspMapPoints.end());
+    return mspMapPoints.items();
+}
+
+std::shared_ptr<const vector<KeyFrame*> > Map::GetKeyFramesSnapshot()
+{
+    unique_lock<mutex> lock(mMutexMap);
+    return mspKeyFrames.Snapshot();
+}
+
+std::shared_ptr<const vector<MapPoint*> > Map::GetMapPointsSnapshot()
+{
+    unique_lock<mutex> lock(mMutexMap);
+    return mspMapPoints.Snapshot();
 }
 
 long unsigned int Map::MapPointsInMap()
@@ -216,7 +314,7 @@ void Map::clear()
 //    for(set<MapPoint*>::iterator sit=mspMapPoints.begin(), send=mspMapPoints.end(); sit!=send; sit++)
 //        delete *sit;
 
-    for(set<KeyFrame*>::iterator sit=mspKeyFrames.begin(), send=mspKeyFrames.end(); sit!=send; sit++)
+    for(SlotMap<KeyFrame>::const_iterator sit=mspKeyFrames.begin(), send=mspKeyFrames.end(); sit!=send; sit++)
     {
         KeyFrame* pKF = *sit;
         pKF->UpdateMap(static_cast<Map*>(NULL));
@@ -225,6 +323,10 @@ void Map::clear()
 
     mspMapPoints.clear();
     mspKeyFrames.clear();
+    {
+        unique_lock<mutex> lockIndex(mMutexPointIndex);
+        mPointIndex.clear();
+    }
     mnMaxKFid = mnInitKFid;
     mbImuInitialized = false;
     mvpReferenceMapPoints.clear();
@@ -258,7 +360,7 @@ void Map::ApplyScaledRotation(const Sophus::SE3f &T, const float s, const bool b
     Eigen::Matrix3f Ryw = Tyw.rotationMatrix();
     Eigen::Vector3f tyw = Tyw.translation();
 
-    for(set<KeyFrame*>::iterator sit=mspKeyFrames.begin(); sit!=mspKeyFrames.end(); sit++)
+    for(SlotMap<KeyFrame>::const_iterator sit=mspKeyFrames.begin(); sit!=mspKeyFrames.end(); sit++)
     {
         KeyFrame* pKF = *sit;
         Sophus::SE3f Twc = pKF->GetPoseInverse();
@@ -273,7 +375,7 @@ void Map::ApplyScaledRotation(const Sophus::SE3f &T, const float s, const bool b
             pKF->SetVelocity(Ryw*Vw*s);
 
     }
-    for(set<MapPoint*>::iterator sit=mspMapPoints.begin(); sit!=mspMapPoints.end(); sit++)
+    for(SlotMap<MapPoint>::const_iterator sit=mspMapPoints.begin(); sit!=mspMapPoints.end(); sit++)
     {
         MapPoint* pMP = *sit;
         pMP->SetWorldPos(s * Ryw * pMP->GetWorldPos() + tyw);
@@ -358,8 +460,11 @@ void Map::SetLastMapChange(int currentChangeId)
 
 void Map::PreSave(std::set<GeometricCamera*> &spCams)
 {
+    // Erasing observations can set points bad, which erases them from the slot map, so iterate over a copy
+    const vector<MapPoint*> vpMPs(mspMapPoints.begin(),mspMapPoints.end());
+
     int nMPWithoutObs = 0;
-    for(MapPoint* pMPi : mspMapPoints)
+    for(MapPoint* pMPi : vpMPs)
     {
         if(!pMPi || pMPi->isBad())
             continue;
@@ -368,8 +473,8 @@ void Map::PreSave(std::set<GeometricCamera*> &spCams)
         {
             nMPWithoutObs++;
         }
-        map<KeyFrame*, std::tuple<int,int>> mpObs = pMPi->GetObservations();
-        for(map<KeyFrame*, std::tuple<int,int>>::iterator it= mpObs.begin(), end=mpObs.end(); it!=end; ++it)
+        ObservationList mpObs = pMPi->GetObservations();
+        for(ObservationList::iterator it= mpObs.begin(), end=mpObs.end(); it!=end; ++it)
         {
             if(it->first->GetMap() != this || it->first->isBad())
             {
@@ -388,15 +493,19 @@ void Map::PreSave(std::set<GeometricCamera*> &spCams)
     }
 
 
+    // PreSave of the elements looks up membership in sets
+    set<KeyFrame*> spKeyFrames(mspKeyFrames.begin(),mspKeyFrames.end());
+    set<MapPoint*> spMapPoints(mspMapPoints.begin(),mspMapPoints.end());
+
     // Backup of MapPoints
     mvpBackupMapPoints.clear();
-    for(MapPoint* pMPi : mspMapPoints)
+    for(MapPoint* pMPi : vpMPs)
     {
         if(!pMPi || pMPi->isBad())
             continue;
 
         mvpBackupMapPoints.push_back(pMPi);
-        pMPi->PreSave(mspKeyFrames,mspMapPoints);
+        pMPi->PreSave(spKeyFrames,spMapPoints);
     }
 
     // Backup of KeyFrames
@@ -407,7 +516,7 @@ void Map::PreSave(std::set<GeometricCamera*> &spCams)
             continue;
 
         mvpBackupKeyFrames.push_back(pKFi);
-        pKFi->PreSave(mspKeyFrames,mspMapPoints, spCams);
+        pKFi->PreSave(spKeyFrames,spMapPoints, spCams);
     }
 
     mnBackupKFinitialID = -1;
@@ -426,8 +535,10 @@ void Map::PreSave(std::set<GeometricCamera*> &spCams)
 
 void Map::PostLoad(KeyFrameDatabase* pKFDB, ORBVocabulary* pORBVoc/*, map<long unsigned int, KeyFrame*>& mpKeyFrameId*/, map<unsigned int, GeometricCamera*> &mpCams)
 {
-    std::copy(mvpBackupMapPoints.begin(), mvpBackupMapPoints.end(), std::inserter(mspMapPoints, mspMapPoints.begin()));
-    std::copy(mvpBackupKeyFrames.begin(), mvpBackupKeyFrames.end(), std::inserter(mspKeyFrames, mspKeyFrames.begin()));
+    for(MapPoint* pMPi : mvpBackupMapPoints)
+        mspMapPoints.insert(pMPi);
+    for(KeyFrame* pKFi : mvpBackupKeyFrames)
+        mspKeyFrames.insert(pKFi);
 
     map<long unsigned int,MapPoint*> mpMapPointId;
     for(MapPoint* pMPi : mspMapPoints)
@@ -458,6 +569,9 @@ void Map::PostLoad(KeyFrameDatabase* pKFDB, ORBVocabulary* pORBVoc/*, map<long u
             continue;
 
         pMPi->PostLoad(mpKeyFrameId, mpMapPointId);
+
+        unique_lock<mutex> lock(mMutexPointIndex);
+        mPointIndex.insert(pMPi,pMPi->GetWorldPos());
     }
 
     for(KeyFrame* pKFi : mspKeyFrames)
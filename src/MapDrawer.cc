@@ -138,7 +138,9 @@ void MapDrawer::DrawMapPoints()
     if(!pActiveMap)
         return;
 
-    const vector<MapPoint*> &vpMPs = pActiveMap->GetAllMapPoints();
+    // Shared view of the points, not copied again while the map does not change
+    const std::shared_ptr<const vector<MapPoint*> > pvpMPs = pActiveMap->GetMapPointsSnapshot();
+    const vector<MapPoint*> &vpMPs = *pvpMPs;
     const vector<MapPoint*> &vpRefMPs = pActiveMap->GetReferenceMapPoints();
 
     set<MapPoint*> spRefMPs(vpRefMPs.begin(), vpRefMPs.end());
@@ -189,7 +191,8 @@ void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph, const b
     if(!pActiveMap)
         return;
 
-    const vector<KeyFrame*> vpKFs = pActiveMap->GetAllKeyFrames();
+    const std::shared_ptr<const vector<KeyFrame*> > pvpKFs = pActiveMap->GetKeyFramesSnapshot();
+    const vector<KeyFrame*> &vpKFs = *pvpKFs;
 
     if(bDrawKF)
     {
@@ -18,6 +18,7 @@
 
 #include "MapPoint.h"
 #include "ORBmatcher.h"
+#include "EpochManager.h"
 
 #include<mutex>
 
@@ -26,6 +27,7 @@ namespace ORB_SLAM3
 
 long unsigned int MapPoint::nNextId=0;
 mutex MapPoint::mGlobalMutex;
+EpochManager* MapPoint::mpEpochManager = NULL;
 
 MapPoint::MapPoint():
     mnFirstKFid(0), mnFirstFrame(0), nObs(0), mnTrackReferenceForFrame(0),
@@ -43,9 +45,8 @@ MapPoint::MapPoint(const Eigen::Vector3f &Pos, KeyFrame *pRefKF, Map* pMap):
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap),
     mnOriginMapId(pMap->GetId())
 {
-    SetWorldPos(Pos);
-
     mNormalVector.setZero();
+    SetWorldPos(Pos);
 
     mbTrackInViewR = false;
     mbTrackInView = false;
@@ -68,6 +69,8 @@ MapPoint::MapPoint(const double invDepth, cv::Point2f uv_init, KeyFrame* pRefKF,
     mpHostKF = pHostKF;
 
     mNormalVector.setZero();
+    mWorldPos.setZero();
+    PublishGeometry();
 
     // Worldpos is not set
     // MapPoints can be created from Tracking and Local Mapping. This mutex avoid conflicts with id.
@@ -107,6 +110,7 @@ MapPoint::MapPoint(const Eigen::Vector3f &Pos, Map* pMap, Frame* pFrame, const i
 
     mfMaxDistance = dist*levelScaleFactor;
     mfMinDistance = mfMaxDistance/pFrame->mvScaleFactors[nLevels-1];
+    PublishGeometry();
 
     pFrame->mDescriptors.row(idxF).copyTo(mDescriptor);
 
@@ -116,19 +120,48 @@ MapPoint::MapPoint(const Eigen::Vector3f &Pos, Map* pMap, Frame* pFrame, const i
 }
 
 void MapPoint::SetWorldPos(const Eigen::Vector3f &Pos) {
-    unique_lock<mutex> lock2(mGlobalMutex);
-    unique_lock<mutex> lock(mMutexPos);
-    mWorldPos = Pos;
+    {
+        unique_lock<mutex> lock2(mGlobalMutex);
+        unique_lock<mutex> lock(mMutexPos);
+        mWorldPos = Pos;
+        PublishGeometry();
+    }
+
+    // Keep the spatial index of the map up to date (nothing to do if the point is not in the map yet)
+    Map* pMap = GetMap();
+    if(pMap)
+        pMap->UpdateMapPointPosition(this,Pos);
 }
 
 Eigen::Vector3f MapPoint::GetWorldPos() {
-    unique_lock<mutex> lock(mMutexPos);
-    return mWorldPos;
+    Eigen::Vector3f Pos;
+    mGeometry.Read(Pos.data(),GEOM_POS,3);
+    return Pos;
 }
 
 Eigen::Vector3f MapPoint::GetNormal() {
-    unique_lock<mutex> lock(mMutexPos);
-    return mNormalVector;
+    Eigen::Vector3f Normal;
+    mGeometry.Read(Normal.data(),GEOM_NORMAL,3);
+    return Normal;
+}
+
+void MapPoint::GetGeometry(Eigen::Vector3f &Pos, Eigen::Vector3f &Normal, float &minDistance, float &maxDistance) {
+    float geom[GEOM_SIZE];
+    mGeometry.Read(geom);
+    Pos = Eigen::Map<const Eigen::Vector3f>(geom+GEOM_POS);
+    Normal = Eigen::Map<const Eigen::Vector3f>(geom+GEOM_NORMAL);
+    minDistance = geom[GEOM_MIN_DIST];
+    maxDistance = geom[GEOM_MAX_DIST];
+}
+
+void MapPoint::PublishGeometry()
+{
+    float geom[GEOM_SIZE];
+    Eigen::Map<Eigen::Vector3f>(geom+GEOM_POS) = mWorldPos;
+    Eigen::Map<Eigen::Vector3f>(geom+GEOM_NORMAL) = mNormalVector;
+    geom[GEOM_MIN_DIST] = mfMinDistance;
+    geom[GEOM_MAX_DIST] = mfMaxDistance;
+    mGeometry.Write(geom);
 }
 
 
@@ -141,13 +174,26 @@ KeyFrame* MapPoint::GetReferenceKeyFrame()
 void MapPoint::AddObservation(KeyFrame* pKF, int idx)
 {
     unique_lock<mutex> lock(mMutexFeatures);
+
+    // SetBadFlag already erased the covisibility of the observations, a new one would never be erased
+    if(mbBad)
+    {
+        lock.unlock();
+        // The keyframe may keep the match, it is erased before the point is released
+        if(mpEpochManager)
+            mpEpochManager->AddLinkCandidate(pKF);
+        return;
+    }
+
     tuple<int,int> indexes;
 
-    if(mObservations.count(pKF)){
-        indexes = mObservations[pKF];
+    ObservationList::iterator it = mObservations.find(pKF);
+    if(it!=mObservations.end()){
+        indexes = it->second;
     }
     else{
         indexes = tuple<int,int>(-1,-1);
+        UpdateCovisibility(pKF,mObservations,1);
     }
 
     if(pKF -> NLeft != -1 && idx >= pKF -> NLeft){
@@ -157,7 +203,7 @@ void MapPoint::AddObservation(KeyFrame* pKF, int idx)
         get<0>(indexes) = idx;
     }
 
-    mObservations[pKF]=indexes;
+    mObservations.set(pKF,indexes);
 
     if(!pKF->mpCamera2 && pKF->mvuRight[idx]>=0)
         nObs+=2;
@@ -170,9 +216,10 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
     bool bBad=false;
     {
         unique_lock<mutex> lock(mMutexFeatures);
-        if(mObservations.count(pKF))
+        ObservationList::iterator it = mObservations.find(pKF);
+        if(it!=mObservations.end())
         {
-            tuple<int,int> indexes = mObservations[pKF];
+            tuple<int,int> indexes = it->second;
             int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
 
             if(leftIndex != -1){
@@ -186,8 +233,9 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
             }
 
             mObservations.erase(pKF);
+            UpdateCovisibility(pKF,mObservations,-1);
 
-            if(mpRefKF==pKF)
+            if(mpRefKF==pKF && !mObservations.empty())
                 mpRefKF=mObservations.begin()->first;
 
             // If only 2 observations or less, discard point
@@ -201,7 +249,7 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
 }
 
 
-std::map<KeyFrame*, std::tuple<int,int>>  MapPoint::GetObservations()
+ObservationList MapPoint::GetObservations()
 {
     unique_lock<mutex> lock(mMutexFeatures);
     return mObservations;
@@ -215,15 +263,19 @@ int MapPoint::Observations()
 
 void MapPoint::SetBadFlag()
 {
-    map<KeyFrame*, tuple<int,int>> obs;
+    ObservationList obs;
+    bool bWasBad;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
+        bWasBad = mbBad;
         mbBad=true;
         obs = mObservations;
         mObservations.clear();
     }
-    for(map<KeyFrame*, tuple<int,int>>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    EraseCovisibility(obs);
+    ClearCaches();
+    for(ObservationList::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
         int leftIndex = get<0>(mit -> second), rightIndex = get<1>(mit -> second);
@@ -236,6 +288,42 @@ void MapPoint::SetBadFlag()
     }
 
     mpMap->EraseMapPoint(this);
+
+    // Released once no thread can reach it anymore
+    if(mpEpochManager && !bWasBad)
+        mpEpochManager->Retire(this,ObserverKeyFrames(obs));
+}
+
+vector<KeyFrame*> MapPoint::ObserverKeyFrames(const ObservationList &obs)
+{
+    vector<KeyFrame*> vpKFs;
+    vpKFs.reserve(obs.size());
+    for(ObservationList::const_iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+        vpKFs.push_back(mit->first);
+    return vpKFs;
+}
+
+void MapPoint::UpdateCovisibility(KeyFrame* pKF, const ObservationList &obs, const int nDelta)
+{
+    for(ObservationList::const_iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    {
+        if(mit->first==pKF)
+            continue;
+        pKF->UpdateCovisibility(mit->first,nDelta);
+        mit->first->UpdateCovisibility(pKF,nDelta);
+    }
+}
+
+void MapPoint::EraseCovisibility(const ObservationList &obs)
+{
+    for(ObservationList::const_iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    {
+        for(ObservationList::const_iterator mit2=mit+1; mit2!=mend; mit2++)
+        {
+            mit->first->UpdateCovisibility(mit2->first,-1);
+            mit2->first->UpdateCovisibility(mit->first,-1);
+        }
+    }
 }
 
 MapPoint* MapPoint::GetReplaced()
@@ -251,19 +339,23 @@ void MapPoint::Replace(MapPoint* pMP)
         return;
 
     int nvisible, nfound;
-    map<KeyFrame*,tuple<int,int>> obs;
+    ObservationList obs;
+    bool bWasBad;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
         obs=mObservations;
         mObservations.clear();
+        bWasBad = mbBad;
         mbBad=true;
         nvisible = mnVisible;
         nfound = mnFound;
         mpReplaced = pMP;
     }
+    EraseCovisibility(obs);
+    ClearCaches();
 
-    for(map<KeyFrame*,tuple<int,int>>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(ObservationList::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
     {
         // Replace measurement in keyframe
         KeyFrame* pKF = mit->first;
@@ -297,6 +389,10 @@ void MapPoint::Replace(MapPoint* pMP)
     pMP->ComputeDistinctiveDescriptors();
 
     mpMap->EraseMapPoint(this);
+
+    // Released once no thread can reach it anymore
+    if(mpEpochManager && !bWasBad)
+        mpEpochManager->Retire(this,ObserverKeyFrames(obs));
 }
 
 bool MapPoint::isBad()
@@ -328,10 +424,7 @@ float MapPoint::GetFoundRatio()
 
 void MapPoint::ComputeDistinctiveDescriptors()
 {
-    // Retrieve all observed descriptors
-    vector<cv::Mat> vDescriptors;
-
-    map<KeyFrame*,tuple<int,int>> observations;
+    ObservationList observations;
 
     {
         unique_lock<mutex> lock1(mMutexFeatures);
@@ -343,9 +436,11 @@ void MapPoint::ComputeDistinctiveDescriptors()
     if(observations.empty())
         return;
 
-    vDescriptors.reserve(observations.size());
+    // Retrieve all observed keypoints
+    vector<pair<KeyFrame*,int> > vObs;
+    vObs.reserve(2*observations.size());
 
-    for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+    for(ObservationList::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
 
@@ -354,40 +449,46 @@ void MapPoint::ComputeDistinctiveDescriptors()
             int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
 
             if(leftIndex != -1){
-                vDescriptors.push_back(pKF->mDescriptors.row(leftIndex));
+                vObs.push_back(make_pair(pKF,leftIndex));
             }
             if(rightIndex != -1){
-                vDescriptors.push_back(pKF->mDescriptors.row(rightIndex));
+                vObs.push_back(make_pair(pKF,rightIndex));
             }
         }
     }
 
-    if(vDescriptors.empty())
+    if(vObs.empty())
         return;
 
-    // Compute distances between them
-    const size_t N = vDescriptors.size();
+    unique_lock<mutex> lockCache(mMutexCache);
 
-    float Distances[N][N];
-    for(size_t i=0;i<N;i++)
+    // Update the distances with the observations erased and added since the last call
+    sort(vObs.begin(),vObs.end());
+    for(size_t i=mvDescriptorCache.size(); i-->0;)
     {
-        Distances[i][i]=0;
-        for(size_t j=i+1;j<N;j++)
-        {
-            int distij = ORBmatcher::DescriptorDistance(vDescriptors[i],vDescriptors[j]);
-            Distances[i][j]=distij;
-            Distances[j][i]=distij;
-        }
+        if(!binary_search(vObs.begin(),vObs.end(),make_pair(mvDescriptorCache[i].pKF,mvDescriptorCache[i].idx)))
+            EraseCachedDescriptor(i);
+    }
+
+    vector<pair<KeyFrame*,int> > vCached;
+    vCached.reserve(mvDescriptorCache.size());
+    for(size_t i=0; i<mvDescriptorCache.size(); i++)
+        vCached.push_back(make_pair(mvDescriptorCache[i].pKF,mvDescriptorCache[i].idx));
+    sort(vCached.begin(),vCached.end());
+
+    for(size_t i=0; i<vObs.size(); i++)
+    {
+        if(!binary_search(vCached.begin(),vCached.end(),vObs[i]))
+            AddCachedDescriptor(vObs[i].first,vObs[i].second);
     }
 
     // Take the descriptor with least median distance to the rest
+    const size_t N = mvDescriptorCache.size();
     int BestMedian = INT_MAX;
     int BestIdx = 0;
     for(size_t i=0;i<N;i++)
     {
-        vector<int> vDists(Distances[i],Distances[i]+N);
-        sort(vDists.begin(),vDists.end());
-        int median = vDists[0.5*(N-1)];
+        int median = mvDescriptorCache[i].vSortedDistances[(N-1)/2];
 
         if(median<BestMedian)
         {
@@ -398,8 +499,69 @@ void MapPoint::ComputeDistinctiveDescriptors()
 
     {
         unique_lock<mutex> lock(mMutexFeatures);
-        mDescriptor = vDescriptors[BestIdx].clone();
+        mDescriptor = mvDescriptorCache[BestIdx].descriptor.clone();
+    }
+}
+
+void MapPoint::AddCachedDescriptor(KeyFrame* pKF, const int idx)
+{
+    DescriptorEntry entry;
+    entry.pKF = pKF;
+    entry.idx = idx;
+    entry.descriptor = pKF->mDescriptors.row(idx).clone();
+    entry.vSortedDistances.reserve(mvDescriptorCache.size()+1);
+    entry.vSortedDistances.push_back(0);
+
+    for(size_t i=0; i<mvDescriptorCache.size(); i++)
+    {
+        vector<int> &vDists = mvDescriptorCache[i].vSortedDistances;
+        const int dist = ORBmatcher::DescriptorDistance(entry.descriptor,mvDescriptorCache[i].descriptor);
+        vDists.insert(upper_bound(vDists.begin(),vDists.end(),dist),dist);
+        entry.vSortedDistances.push_back(dist);
+    }
+    sort(entry.vSortedDistances.begin(),entry.vSortedDistances.end());
+
+    mvDescriptorCache.push_back(entry);
+}
+
+void MapPoint::EraseCachedDescriptor(const size_t i)
+{
+    const cv::Mat &descriptor = mvDescriptorCache[i].descriptor;
+    for(size_t j=0; j<mvDescriptorCache.size(); j++)
+    {
+        if(j==i)
+            continue;
+        vector<int> &vDists = mvDescriptorCache[j].vSortedDistances;
+        const int dist = ORBmatcher::DescriptorDistance(descriptor,mvDescriptorCache[j].descriptor);
+        vDists.erase(lower_bound(vDists.begin(),vDists.end(),dist));
+    }
+
+    mvDescriptorCache.erase(mvDescriptorCache.begin()+i);
+}
+
+size_t MapPoint::GetMemoryUsage()
+{
+    size_t nBytes = sizeof(MapPoint);
+    {
+        unique_lock<mutex> lock(mMutexFeatures);
+        nBytes += mDescriptor.total()*mDescriptor.elemSize();
+        if(mObservations.size()>ObservationList::INLINE_CAPACITY)
+            nBytes += mObservations.size()*sizeof(ObservationList::Observation);
     }
+
+    unique_lock<mutex> lockCache(mMutexCache);
+    for(size_t i=0; i<mvDescriptorCache.size(); i++)
+        nBytes += sizeof(DescriptorEntry) + mvDescriptorCache[i].descriptor.total()*mvDescriptorCache[i].descriptor.elemSize() +
+                  mvDescriptorCache[i].vSortedDistances.capacity()*sizeof(int);
+    nBytes += mvNormalCache.capacity()*sizeof(NormalEntry);
+    return nBytes;
+}
+
+void MapPoint::ClearCaches()
+{
+    unique_lock<mutex> lockCache(mMutexCache);
+    vector<DescriptorEntry>().swap(mvDescriptorCache);
+    vector<NormalEntry>().swap(mvNormalCache);
 }
 
 cv::Mat MapPoint::GetDescriptor()
@@ -411,8 +573,9 @@ cv::Mat MapPoint::GetDescriptor()
 tuple<int,int> MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    if(mObservations.count(pKF))
-        return mObservations[pKF];
+    ObservationList::const_iterator it = mObservations.find(pKF);
+    if(it!=mObservations.end())
+        return it->second;
     else
         return tuple<int,int>(-1,-1);
 }
@@ -425,7 +588,7 @@ bool MapPoint::IsInKeyFrame(KeyFrame *pKF)
 
 void MapPoint::UpdateNormalAndDepth()
 {
-    map<KeyFrame*,tuple<int,int>> observations;
+    ObservationList observations;
     KeyFrame* pRefKF;
     Eigen::Vector3f Pos;
     {
@@ -442,33 +605,81 @@ void MapPoint::UpdateNormalAndDepth()
         return;
 
     Eigen::Vector3f normal;
-    normal.setZero();
-    int n=0;
-    for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+    int n;
     {
-        KeyFrame* pKF = mit->first;
+        unique_lock<mutex> lockCache(mMutexCache);
 
-        tuple<int,int> indexes = mit -> second;
-        int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
+        // All viewing directions change with the position
+        if(mvNormalCache.empty() || Pos!=mNormalCachePos)
+        {
+            mvNormalCache.clear();
+            mNormalSum.setZero();
+            mNormalCachePos = Pos;
+        }
 
-        if(leftIndex != -1){
-            Eigen::Vector3f Owi = pKF->GetCameraCenter();
-            Eigen::Vector3f normali = Pos - Owi;
-            normal = normal + normali / normali.norm();
-            n++;
+        vector<pair<KeyFrame*,int> > vObs;
+        vObs.reserve(2*observations.size());
+        for(ObservationList::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        {
+            int leftIndex = get<0>(mit->second), rightIndex = get<1>(mit->second);
+            if(leftIndex != -1)
+                vObs.push_back(make_pair(mit->first,leftIndex));
+            if(rightIndex != -1)
+                vObs.push_back(make_pair(mit->first,rightIndex));
         }
-        if(rightIndex != -1){
-            Eigen::Vector3f Owi = pKF->GetRightCameraCenter();
+        sort(vObs.begin(),vObs.end());
+
+        // Drop the directions of erased observations and of keyframes that moved
+        vector<pair<KeyFrame*,int> > vCached;
+        vCached.reserve(mvNormalCache.size());
+        for(size_t i=mvNormalCache.size(); i-->0;)
+        {
+            NormalEntry &entry = mvNormalCache[i];
+            if(entry.pKF->GetPoseVersion()!=entry.nPoseVersion ||
+               !binary_search(vObs.begin(),vObs.end(),make_pair(entry.pKF,entry.idx)))
+            {
+                mNormalSum -= entry.direction;
+                entry = mvNormalCache.back();
+                mvNormalCache.pop_back();
+            }
+            else
+                vCached.push_back(make_pair(entry.pKF,entry.idx));
+        }
+        sort(vCached.begin(),vCached.end());
+
+        for(size_t i=0; i<vObs.size(); i++)
+        {
+            if(binary_search(vCached.begin(),vCached.end(),vObs[i]))
+                continue;
+
+            KeyFrame* pKF = vObs[i].first;
+            const int idx = vObs[i].second;
+            tuple<int,int> indexes = observations.find(pKF)->second;
+
+            NormalEntry entry;
+            entry.pKF = pKF;
+            entry.idx = idx;
+            entry.nPoseVersion = pKF->GetPoseVersion();
+            Eigen::Vector3f Owi = (idx==get<0>(indexes)) ? pKF->GetCameraCenter() : pKF->GetRightCameraCenter();
             Eigen::Vector3f normali = Pos - Owi;
-            normal = normal + normali / normali.norm();
-            n++;
+            entry.direction = normali / normali.norm();
+
+            mNormalSum += entry.direction;
+            mvNormalCache.push_back(entry);
         }
+
+        normal = mNormalSum;
+        n = mvNormalCache.size();
     }
 
     Eigen::Vector3f PC = Pos - pRefKF->GetCameraCenter();
     const float dist = PC.norm();
 
-    tuple<int ,int> indexes = observations[pRefKF];
+    ObservationList::const_iterator itRef = observations.find(pRefKF);
+    if(itRef==observations.end())
+        return;
+
+    tuple<int ,int> indexes = itRef->second;
     int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
     int level;
     if(pRefKF -> NLeft == -1){
@@ -490,6 +701,7 @@ void MapPoint::UpdateNormalAndDepth()
         mfMaxDistance = dist*levelScaleFactor;
         mfMinDistance = mfMaxDistance/pRefKF->mvScaleFactors[nLevels-1];
         mNormalVector = normal/n;
+        PublishGeometry();
     }
 }
 
@@ -497,27 +709,28 @@ void MapPoint::SetNormalVector(const Eigen::Vector3f& normal)
 {
     unique_lock<mutex> lock3(mMutexPos);
     mNormalVector = normal;
+    PublishGeometry();
 }
 
 float MapPoint::GetMinDistanceInvariance()
 {
-    unique_lock<mutex> lock(mMutexPos);
-    return 0.8f * mfMinDistance;
+    float minDistance;
+    mGeometry.Read(&minDistance,GEOM_MIN_DIST,1);
+    return 0.8f * minDistance;
 }
 
 float MapPoint::GetMaxDistanceInvariance()
 {
-    unique_lock<mutex> lock(mMutexPos);
-    return 1.2f * mfMaxDistance;
+    float maxDistance;
+    mGeometry.Read(&maxDistance,GEOM_MAX_DIST,1);
+    return 1.2f * maxDistance;
 }
 
 int MapPoint::PredictScale(const float &currentDist, KeyFrame* pKF)
 {
-    float ratio;
-    {
-        unique_lock<mutex> lock(mMutexPos);
-        ratio = mfMaxDistance/currentDist;
-    }
+    float maxDistance;
+    mGeometry.Read(&maxDistance,GEOM_MAX_DIST,1);
+    const float ratio = maxDistance/currentDist;
 
     int nScale = ceil(log(ratio)/pKF->mfLogScaleFactor);
     if(nScale<0)
@@ -530,11 +743,9 @@ int MapPoint::PredictScale(const float &currentDist, KeyFrame* pKF)
 
 int MapPoint::PredictScale(const float &currentDist, Frame* pF)
 {
-    float ratio;
-    {
-        unique_lock<mutex> lock(mMutexPos);
-        ratio = mfMaxDistance/currentDist;
-    }
+    float maxDistance;
+    mGeometry.Read(&maxDistance,GEOM_MAX_DIST,1);
+    const float ratio = maxDistance/currentDist;
 
     int nScale = ceil(log(ratio)/pF->mfLogScaleFactor);
     if(nScale<0)
@@ -548,7 +759,7 @@ int MapPoint::PredictScale(const float &currentDist, Frame* pF)
 void MapPoint::PrintObservations()
 {
     cout << "MP_OBS: MP " << mnId << endl;
-    for(map<KeyFrame*,tuple<int,int>>::iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
+    for(ObservationList::iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
     {
         KeyFrame* pKFi = mit->first;
         tuple<int,int> indexes = mit->second;
@@ -577,8 +788,10 @@ void MapPoint::PreSave(set<KeyFrame*>& spKF,set<MapPoint*>& spMP)
 
     mBackupObservationsId1.clear();
     mBackupObservationsId2.clear();
-    // Save the id and position in each KF who view it
-    for(std::map<KeyFrame*,std::tuple<int,int> >::const_iterator it = mObservations.begin(), end = mObservations.end(); it != end; ++it)
+    // Save the id and position in each KF who view it. Erasing swaps the last record into the erased
+    // slot, so the observations of KFs that are not saved are erased after the loop
+    vector<KeyFrame*> vpErasedKFs;
+    for(ObservationList::const_iterator it = mObservations.begin(), end = mObservations.end(); it != end; ++it)
     {
         KeyFrame* pKFi = it->first;
         if(spKF.find(pKFi) != spKF.end())
@@ -588,9 +801,11 @@ void MapPoint::PreSave(set<KeyFrame*>& spKF,set<MapPoint*>& spMP)
         }
         else
         {
-            EraseObservation(pKFi);
+            vpErasedKFs.push_back(pKFi);
         }
     }
+    for(KeyFrame* pKFi : vpErasedKFs)
+        EraseObservation(pKFi);
 
     // Save the id of the reference KF
     if(spKF.find(mpRefKF) != spKF.end())
@@ -623,12 +838,16 @@ void MapPoint::PostLoad(map<long unsigned int, KeyFrame*>& mpKFid, map<long unsi
         std::tuple<int, int> indexes = tuple<int,int>(it->second,it2->second);
         if(pKFi)
         {
-           mObservations[pKFi] = indexes;
+           UpdateCovisibility(pKFi,mObservations,1);
+           mObservations.set(pKFi,indexes);
         }
     }
 
     mBackupObservationsId1.clear();
     mBackupObservationsId2.clear();
+
+    unique_lock<mutex> lock(mMutexPos);
+    PublishGeometry();
 }
 
 } //namespace ORB_SLAM
@@ -0,0 +1,57 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "MapPointSnapshot.h"
+#include "MapPoint.h"
+
+namespace ORB_SLAM3
+{
+
+void MapPointSnapshot::View::resize(const size_t n)
+{
+    mvXc.resize(n);
+    mvYc.resize(n);
+    mvZc.resize(n);
+    mvU.resize(n);
+    mvV.resize(n);
+    mvDepth.resize(n);
+    mvDist.resize(n);
+    mvViewCos.resize(n);
+    mvbInView.resize(n);
+}
+
+void MapPointSnapshot::Assign(const std::vector<MapPoint*> &vpMPs)
+{
+    const size_t n = vpMPs.size();
+    mvpMapPoints = vpMPs;
+    mvX.resize(n); mvY.resize(n); mvZ.resize(n);
+    mvNx.resize(n); mvNy.resize(n); mvNz.resize(n);
+    mvMinDistance.resize(n);
+    mvMaxDistance.resize(n);
+
+    Eigen::Vector3f pos, normal;
+    for(size_t i=0; i<n; i++)
+    {
+        vpMPs[i]->GetGeometry(pos,normal,mvMinDistance[i],mvMaxDistance[i]);
+        mvX[i] = pos(0); mvY[i] = pos(1); mvZ[i] = pos(2);
+        mvNx[i] = normal(0); mvNy[i] = normal(1); mvNz[i] = normal(2);
+    }
+}
+
+} //namespace ORB_SLAM
@@ -58,8 +58,16 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <vector>
 #include <iostream>
+#include <cstring>
 
 #include "ORBextractor.h"
+#include "FASTdetector.h"
+#include "ThreadPool.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ORB_AVX2_DESCRIPTORS
+#include <immintrin.h>
+#endif
 
 
 using namespace cv;
@@ -104,46 +112,58 @@ namespace ORB_SLAM3
 
 
     const float factorPI = (float)(CV_PI/180.f);
-    static void computeOrbDescriptor(const KeyPoint& kpt,
-                                     const Mat& img, const Point* pattern,
-                                     uchar* desc)
+
+    // Rotate the rBRIEF pattern of a keypoint once and store it as pixel offsets from the keypoint.
+    // ofs0/ofs1 hold the first/second point of each of the 256 tests.
+    static void computeRotatedOffsets(const KeyPoint& kpt, const int step, const Point* pattern,
+                                      int* ofs0, int* ofs1)
     {
         float angle = (float)kpt.angle*factorPI;
         float a = (float)cos(angle), b = (float)sin(angle);
 
-        const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
-        const int step = (int)img.step;
+#define GET_OFFSET(idx) \
+        (cvRound(pattern[idx].x*b + pattern[idx].y*a)*step + \
+         cvRound(pattern[idx].x*a - pattern[idx].y*b))
 
-#define GET_VALUE(idx) \
-        center[cvRound(pattern[idx].x*b + pattern[idx].y*a)*step + \
-               cvRound(pattern[idx].x*a - pattern[idx].y*b)]
+        for (int i = 0; i < 256; ++i)
+        {
+            ofs0[i] = GET_OFFSET(2*i);
+            ofs1[i] = GET_OFFSET(2*i+1);
+        }
 
+#undef GET_OFFSET
+    }
 
-        for (int i = 0; i < 32; ++i, pattern += 16)
+    static void compareSamples(const uchar* center, const int* ofs0, const int* ofs1, uchar* desc)
+    {
+        for (int i = 0; i < 32; ++i, ofs0 += 8, ofs1 += 8)
         {
-            int t0, t1, val;
-            t0 = GET_VALUE(0); t1 = GET_VALUE(1);
-            val = t0 < t1;
-            t0 = GET_VALUE(2); t1 = GET_VALUE(3);
-            val |= (t0 < t1) << 1;
-            t0 = GET_VALUE(4); t1 = GET_VALUE(5);
-            val |= (t0 < t1) << 2;
-            t0 = GET_VALUE(6); t1 = GET_VALUE(7);
-            val |= (t0 < t1) << 3;
-            t0 = GET_VALUE(8); t1 = GET_VALUE(9);
-            val |= (t0 < t1) << 4;
-            t0 = GET_VALUE(10); t1 = GET_VALUE(11);
-            val |= (t0 < t1) << 5;
-            t0 = GET_VALUE(12); t1 = GET_VALUE(13);
-            val |= (t0 < t1) << 6;
-            t0 = GET_VALUE(14); t1 = GET_VALUE(15);
-            val |= (t0 < t1) << 7;
+            int val = 0;
+            for (int k = 0; k < 8; ++k)
+                val |= (center[ofs0[k]] < center[ofs1[k]]) << k;
 
             desc[i] = (uchar)val;
         }
+    }
 
-#undef GET_VALUE
+#ifdef ORB_AVX2_DESCRIPTORS
+    // Eight tests (one descriptor byte) per iteration. Each gather loads the 32 bit word ending
+    // at the sample, so no memory after the sampled pixel is touched.
+    __attribute__((target("avx2")))
+    static void compareSamplesAVX2(const uchar* center, const int* ofs0, const int* ofs1, uchar* desc)
+    {
+        const int* base = (const int*)(center - 3);
+        for (int i = 0; i < 32; ++i, ofs0 += 8, ofs1 += 8)
+        {
+            const __m256i idx0 = _mm256_loadu_si256((const __m256i*)ofs0);
+            const __m256i idx1 = _mm256_loadu_si256((const __m256i*)ofs1);
+            const __m256i t0 = _mm256_srli_epi32(_mm256_i32gather_epi32(base, idx0, 1), 24);
+            const __m256i t1 = _mm256_srli_epi32(_mm256_i32gather_epi32(base, idx1, 1), 24);
+
+            desc[i] = (uchar)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(t1, t0)));
+        }
     }
+#endif
 
 
     static int bit_pattern_31_[256*4] =
@@ -407,9 +427,9 @@ namespace ORB_SLAM3
             };
 
     ORBextractor::ORBextractor(int _nfeatures, float _scaleFactor, int _nlevels,
-                               int _iniThFAST, int _minThFAST):
+                               int _iniThFAST, int _minThFAST, int _distribution):
             nfeatures(_nfeatures), scaleFactor(_scaleFactor), nlevels(_nlevels),
-            iniThFAST(_iniThFAST), minThFAST(_minThFAST)
+            iniThFAST(_iniThFAST), minThFAST(_minThFAST), mnDistribution(_distribution), mpThreadPool(NULL)
     {
         mvScaleFactor.resize(nlevels);
         mvLevelSigma2.resize(nlevels);
@@ -430,6 +450,15 @@ namespace ORB_SLAM3
         }
 
         mvImagePyramid.resize(nlevels);
+        mvPyramidBuffers.resize(nlevels);
+        mvBlurredPyramid.resize(nlevels);
+        mvFASTScores.resize(nlevels);
+        mvvToDistributeKeys.resize(nlevels);
+        mvvLevelRows.resize(nlevels);
+        mvvGridCellStart.resize(nlevels);
+        mvvGridCellFill.resize(nlevels);
+        mvvGridKeyCell.resize(nlevels);
+        mvvpGridKeys.resize(nlevels);
 
         mnFeaturesPerLevel.resize(nlevels);
         float factor = 1.0f / scaleFactor;
@@ -778,121 +807,224 @@ namespace ORB_SLAM3
         return vResultKeys;
     }
 
-    void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoints)
+    static bool compareResponse(const cv::KeyPoint* pKP1, const cv::KeyPoint* pKP2){
+        return pKP1->response > pKP2->response;
+    }
+
+    vector<cv::KeyPoint> ORBextractor::DistributeGrid(const vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
+                                                      const int &maxX, const int &minY, const int &maxY, const int &N, const int &level)
     {
-        allKeypoints.resize(nlevels);
+        const int nKeys = vToDistributeKeys.size();
+        if(nKeys<=N)
+            return vToDistributeKeys;
+
+        // Grid with about N cells and the aspect ratio of the image
+        const float width = maxX-minX;
+        const float height = maxY-minY;
+        const int nCols = max(1,(int)round(sqrt(N*width/height)));
+        const int nRows = max(1,(int)round(static_cast<float>(N)/nCols));
+        const float invCellW = nCols/width;
+        const float invCellH = nRows/height;
+        const int nCells = nCols*nRows;
+
+        // Bucket the keypoints with a counting sort: vCellStart[c] is the first entry of cell c in vpCellKeys
+        vector<int>& vCellStart = mvvGridCellStart[level];
+        vector<const cv::KeyPoint*>& vpCellKeys = mvvpGridKeys[level];
+        vCellStart.assign(nCells+1,0);
+        vpCellKeys.resize(nKeys);
+
+        vector<int>& vKeyCell = mvvGridKeyCell[level];
+        vKeyCell.resize(nKeys);
+        for(int i=0; i<nKeys; i++)
+        {
+            const cv::KeyPoint &kp = vToDistributeKeys[i];
+            const int cx = min(nCols-1,max(0,(int)(kp.pt.x*invCellW)));
+            const int cy = min(nRows-1,max(0,(int)(kp.pt.y*invCellH)));
+            vKeyCell[i] = cy*nCols+cx;
+            vCellStart[vKeyCell[i]+1]++;
+        }
 
-        const float W = 35;
+        int nNonEmpty = 0, maxCount = 0;
+        for(int c=0; c<nCells; c++)
+        {
+            const int count = vCellStart[c+1];
+            if(count>0)
+                nNonEmpty++;
+            maxCount = max(maxCount,count);
+            vCellStart[c+1] += vCellStart[c];
+        }
 
-        for (int level = 0; level < nlevels; ++level)
+        vector<int>& vCellFill = mvvGridCellFill[level];
+        vCellFill.assign(vCellStart.begin(),vCellStart.end()-1);
+        for(int i=0; i<nKeys; i++)
+            vpCellKeys[vCellFill[vKeyCell[i]]++] = &vToDistributeKeys[i];
+
+        // Smallest number of keypoints per cell that gives at least N candidates
+        int nPerCell = max(1,N/nNonEmpty);
+        while(nPerCell<maxCount)
         {
-            const int minBorderX = EDGE_THRESHOLD-3;
-            const int minBorderY = minBorderX;
-            const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
-            const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
+            int nCandidates = 0, nCellsWithMore = 0;
+            for(int c=0; c<nCells; c++)
+            {
+                const int count = vCellStart[c+1]-vCellStart[c];
+                nCandidates += min(count,nPerCell);
+                if(count>nPerCell)
+                    nCellsWithMore++;
+            }
 
-            vector<cv::KeyPoint> vToDistributeKeys;
-            vToDistributeKeys.reserve(nfeatures*10);
+            if(nCandidates>=N)
+                break;
 
-            const float width = (maxBorderX-minBorderX);
-            const float height = (maxBorderY-minBorderY);
+            nPerCell += max(1,(N-nCandidates)/nCellsWithMore);
+        }
+        nPerCell = min(nPerCell,maxCount);
+
+        // Keep the best nPerCell of each cell, sorted by response
+        for(int c=0; c<nCells; c++)
+        {
+            vector<const cv::KeyPoint*>::iterator begin = vpCellKeys.begin()+vCellStart[c];
+            vector<const cv::KeyPoint*>::iterator end = vpCellKeys.begin()+vCellStart[c+1];
+            if(end-begin>nPerCell)
+            {
+                nth_element(begin,begin+nPerCell,end,compareResponse);
+                end = begin+nPerCell;
+            }
+            sort(begin,end,compareResponse);
+        }
 
-            const int nCols = width/W;
-            const int nRows = height/W;
-            const int wCell = ceil(width/nCols);
-            const int hCell = ceil(height/nRows);
+        // The best keypoint of every cell goes first, then the second best of every cell and so on.
+        // The last rank that does not fit entirely keeps its strongest keypoints.
+        vector<cv::KeyPoint> vResultKeys;
+        vResultKeys.reserve(N);
+        vector<const cv::KeyPoint*> vpRank;
+        vpRank.reserve(nNonEmpty);
+        for(int r=0; r<nPerCell && (int)vResultKeys.size()<N; r++)
+        {
+            vpRank.clear();
+            for(int c=0; c<nCells; c++)
+            {
+                if(vCellStart[c]+r<vCellStart[c+1])
+                    vpRank.push_back(vpCellKeys[vCellStart[c]+r]);
+            }
 
-            for(int i=0; i<nRows; i++)
+            const int nLeft = N-(int)vResultKeys.size();
+            if((int)vpRank.size()>nLeft)
             {
-                const float iniY =minBorderY+i*hCell;
-                float maxY = iniY+hCell+6;
+                nth_element(vpRank.begin(),vpRank.begin()+nLeft,vpRank.end(),compareResponse);
+                vpRank.resize(nLeft);
+            }
 
-                if(iniY>=maxBorderY-3)
-                    continue;
-                if(maxY>maxBorderY)
-                    maxY = maxBorderY;
+            for(size_t i=0; i<vpRank.size(); i++)
+                vResultKeys.push_back(*vpRank[i]);
+        }
 
-                for(int j=0; j<nCols; j++)
-                {
-                    const float iniX =minBorderX+j*wCell;
-                    float maxX = iniX+wCell+6;
-                    if(iniX>=maxBorderX-6)
-                        continue;
-                    if(maxX>maxBorderX)
-                        maxX = maxBorderX;
+        return vResultKeys;
+    }
 
-                    vector<cv::KeyPoint> vKeysCell;
+    void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoints)
+    {
+        allKeypoints.resize(nlevels);
 
-                    FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                         vKeysCell,iniThFAST,true);
+        // Levels only share read-only data, each one fills its own keypoint vector
+        if(mpThreadPool)
+            mpThreadPool->ParallelFor(nlevels, [&](int level){ComputeKeyPointsLevel(level, allKeypoints[level]);});
+        else
+        {
+            for (int level = 0; level < nlevels; ++level)
+                ComputeKeyPointsLevel(level, allKeypoints[level]);
+        }
+    }
 
-                    /*if(bRight && j <= 13){
-                        FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,10,true);
-                    }
-                    else if(!bRight && j >= 16){
-                        FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,10,true);
-                    }
-                    else{
-                        FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,iniThFAST,true);
-                    }*/
+    void ORBextractor::ComputeKeyPointsLevel(const int level, vector<KeyPoint>& keypoints)
+    {
+        const float W = 35;
 
+        const int minBorderX = EDGE_THRESHOLD-3;
+        const int minBorderY = minBorderX;
+        const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
+        const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
 
-                    if(vKeysCell.empty())
-                    {
-                        FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,minThFAST,true);
-                        /*if(bRight && j <= 13){
-                            FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                                 vKeysCell,5,true);
-                        }
-                        else if(!bRight && j >= 16){
-                            FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                                 vKeysCell,5,true);
-                        }
-                        else{
-                            FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                                 vKeysCell,minThFAST,true);
-                        }*/
-                    }
+        vector<cv::KeyPoint>& vToDistributeKeys = mvvToDistributeKeys[level];
+        vToDistributeKeys.clear();
+        vToDistributeKeys.reserve(nfeatures*10);
+        vector<cv::KeyPoint> vKeysCell;
+
+        const float width = (maxBorderX-minBorderX);
+        const float height = (maxBorderY-minBorderY);
+
+        const int nCols = width/W;
+        const int nRows = height/W;
+        const int wCell = ceil(width/nCols);
+        const int hCell = ceil(height/nRows);
+
+        // Score the whole level once with the lowest threshold, cells are read back for both thresholds
+        FASTdetector::ComputeScores(mvImagePyramid[level],mvFASTScores[level],min(iniThFAST,minThFAST),
+                                    minBorderX+3,maxBorderX-3,minBorderY+3,maxBorderY-3);
+
+        for(int i=0; i<nRows; i++)
+        {
+            const float iniY =minBorderY+i*hCell;
+            float maxY = iniY+hCell+6;
+
+            if(iniY>=maxBorderY-3)
+                continue;
+            if(maxY>maxBorderY)
+                maxY = maxBorderY;
+
+            for(int j=0; j<nCols; j++)
+            {
+                const float iniX =minBorderX+j*wCell;
+                float maxX = iniX+wCell+6;
+                if(iniX>=maxBorderX-6)
+                    continue;
+                if(maxX>maxBorderX)
+                    maxX = maxBorderX;
 
-                    if(!vKeysCell.empty())
+                vKeysCell.clear();
+
+                FASTdetector::DetectInCell(mvFASTScores[level],iniThFAST,iniX,iniY,maxX,maxY,vKeysCell);
+
+                if(vKeysCell.empty())
+                {
+                    FASTdetector::DetectInCell(mvFASTScores[level],minThFAST,iniX,iniY,maxX,maxY,vKeysCell);
+                }
+
+                if(!vKeysCell.empty())
+                {
+                    for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
                     {
-                        for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
-                        {
-                            (*vit).pt.x+=j*wCell;
-                            (*vit).pt.y+=i*hCell;
-                            vToDistributeKeys.push_back(*vit);
-                        }
+                        (*vit).pt.x+=j*wCell;
+                        (*vit).pt.y+=i*hCell;
+                        vToDistributeKeys.push_back(*vit);
                     }
-
                 }
+
             }
+        }
 
-            vector<KeyPoint> & keypoints = allKeypoints[level];
-            keypoints.reserve(nfeatures);
+        keypoints.reserve(nfeatures);
 
+        if(mnDistribution==GRID_DISTRIBUTION)
+            keypoints = DistributeGrid(vToDistributeKeys, minBorderX, maxBorderX,
+                                       minBorderY, maxBorderY,mnFeaturesPerLevel[level], level);
+        else
             keypoints = DistributeOctTree(vToDistributeKeys, minBorderX, maxBorderX,
                                           minBorderY, maxBorderY,mnFeaturesPerLevel[level], level);
 
-            const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
+        const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
 
-            // Add border to coordinates and scale information
-            const int nkps = keypoints.size();
-            for(int i=0; i<nkps ; i++)
-            {
-                keypoints[i].pt.x+=minBorderX;
-                keypoints[i].pt.y+=minBorderY;
-                keypoints[i].octave=level;
-                keypoints[i].size = scaledPatchSize;
-            }
+        // Add border to coordinates and scale information
+        const int nkps = keypoints.size();
+        for(int i=0; i<nkps ; i++)
+        {
+            keypoints[i].pt.x+=minBorderX;
+            keypoints[i].pt.y+=minBorderY;
+            keypoints[i].octave=level;
+            keypoints[i].size = scaledPatchSize;
         }
 
         // compute orientations
-        for (int level = 0; level < nlevels; ++level)
-            computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
+        computeOrientation(mvImagePyramid[level], keypoints, umax);
     }
 
     void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<KeyPoint> > &allKeypoints)
@@ -1074,13 +1206,34 @@ namespace ORB_SLAM3
             computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
     }
 
-    static void computeDescriptors(const Mat& image, vector<KeyPoint>& keypoints, Mat& descriptors,
-                                   const vector<Point>& pattern)
+    // Compute the rBRIEF descriptors of all the keypoints of a level. The descriptor of keypoints[i]
+    // is written straight into row vRows[i] of descriptors.
+    static void computeDescriptors(const Mat& image, const vector<KeyPoint>& keypoints, Mat& descriptors,
+                                   const vector<int>& vRows, const vector<Point>& pattern)
     {
-        descriptors = Mat::zeros((int)keypoints.size(), 32, CV_8UC1);
+        const int step = (int)image.step;
+#ifdef ORB_AVX2_DESCRIPTORS
+        const bool bAVX2 = FASTdetector::GetBackend() == FASTdetector::AVX2;
+#endif
 
+        int ofs[512];
         for (size_t i = 0; i < keypoints.size(); i++)
-            computeOrbDescriptor(keypoints[i], image, &pattern[0], descriptors.ptr((int)i));
+        {
+            const KeyPoint& kpt = keypoints[i];
+            computeRotatedOffsets(kpt, step, &pattern[0], ofs, ofs + 256);
+
+            const uchar* center = &image.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+            uchar* desc = descriptors.ptr(vRows[i]);
+
+#ifdef ORB_AVX2_DESCRIPTORS
+            if(bAVX2)
+            {
+                compareSamplesAVX2(center, ofs, ofs + 256, desc);
+                continue;
+            }
+#endif
+            compareSamples(center, ofs, ofs + 256, desc);
+        }
     }
 
     int ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPoint>& _keypoints,
@@ -1117,73 +1270,136 @@ namespace ORB_SLAM3
         //_keypoints.reserve(nkeypoints);
         _keypoints = vector<cv::KeyPoint>(nkeypoints);
 
-        int offset = 0;
         //Modified for speeding up stereo fisheye matching
+        // Output row of each keypoint: keypoints in the lapping area are stored from the end.
+        // Rows are assigned level by level so that the levels can then be described in any order.
         int monoIndex = 0, stereoIndex = nkeypoints-1;
+        vector<vector<int> >& vvRows = mvvLevelRows;
         for (int level = 0; level < nlevels; ++level)
+        {
+            const vector<KeyPoint>& keypoints = allKeypoints[level];
+            const int nkeypointsLevel = (int)keypoints.size();
+            const float scale = mvScaleFactor[level]; //getScale(level, firstLevel, scaleFactor);
+
+            vector<int>& vRows = vvRows[level];
+            vRows.resize(nkeypointsLevel);
+            for (int i = 0; i < nkeypointsLevel; i++)
+            {
+                Point2f pt = keypoints[i].pt;
+                if (level != 0){
+                    pt *= scale;
+                }
+
+                if(pt.x >= vLappingArea[0] && pt.x <= vLappingArea[1])
+                    vRows[i] = stereoIndex--;
+                else
+                    vRows[i] = monoIndex++;
+            }
+        }
+
+        auto describeLevel = [&](int level)
         {
             vector<KeyPoint>& keypoints = allKeypoints[level];
             int nkeypointsLevel = (int)keypoints.size();
 
             if(nkeypointsLevel==0)
-                continue;
+                return;
 
-            // preprocess the resized image
-            Mat workingMat = mvImagePyramid[level].clone();
-            GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
-
-            // Compute the descriptors
-            //Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);
-            Mat desc = cv::Mat(nkeypointsLevel, 32, CV_8U);
-            computeDescriptors(workingMat, keypoints, desc, pattern);
+            // preprocess the resized image. The level is blurred as an isolated image, as a copy of it would be
+            Mat& workingMat = mvBlurredPyramid[level];
+            GaussianBlur(mvImagePyramid[level], workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101+BORDER_ISOLATED);
 
-            offset += nkeypointsLevel;
+            const vector<int>& vRows = vvRows[level];
 
+            // Compute the descriptors
+            computeDescriptors(workingMat, keypoints, descriptors, vRows, pattern);
 
-            float scale = mvScaleFactor[level]; //getScale(level, firstLevel, scaleFactor);
-            int i = 0;
-            for (vector<KeyPoint>::iterator keypoint = keypoints.begin(),
-                         keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint){
+            float scale = mvScaleFactor[level];
+            for (int i = 0; i < nkeypointsLevel; i++)
+            {
+                KeyPoint& keypoint = keypoints[i];
 
                 // Scale keypoint coordinates
                 if (level != 0){
-                    keypoint->pt *= scale;
+                    keypoint.pt *= scale;
                 }
 
-                if(keypoint->pt.x >= vLappingArea[0] && keypoint->pt.x <= vLappingArea[1]){
-                    _keypoints.at(stereoIndex) = (*keypoint);
-                    desc.row(i).copyTo(descriptors.row(stereoIndex));
-                    stereoIndex--;
-                }
-                else{
-                    _keypoints.at(monoIndex) = (*keypoint);
-                    desc.row(i).copyTo(descriptors.row(monoIndex));
-                    monoIndex++;
-                }
-                i++;
+                _keypoints[vRows[i]] = keypoint;
             }
+        };
+
+        // Each level writes its own rows of the output, the result does not depend on the order
+        if(mpThreadPool)
+            mpThreadPool->ParallelFor(nlevels, describeLevel);
+        else
+        {
+            for (int level = 0; level < nlevels; ++level)
+                describeLevel(level);
         }
         //cout << "[ORBextractor]: extracted " << _keypoints.size() << " KeyPoints" << endl;
         return monoIndex;
     }
 
-    void ORBextractor::ComputePyramid(cv::Mat image)
+    // Fill the EDGE_THRESHOLD border around a level stored inside its bordered buffer, in place.
+    // Same result as copyMakeBorder with BORDER_REFLECT_101+BORDER_ISOLATED without copying the level.
+    static void fillBorderReflect101(Mat& bordered, const int border)
     {
+        const int cols = bordered.cols - 2*border;
+        const int rows = bordered.rows - 2*border;
+
+        for(int y = border; y < border+rows; y++)
+        {
+            uchar* row = bordered.ptr(y) + border;
+            for(int k = 1; k <= border; k++)
+            {
+                row[-k] = row[k];
+                row[cols-1+k] = row[cols-1-k];
+            }
+        }
+
+        const size_t rowBytes = bordered.cols;
+        for(int k = 1; k <= border; k++)
+        {
+            memcpy(bordered.ptr(border-k), bordered.ptr(border+k), rowBytes);
+            memcpy(bordered.ptr(border+rows-1+k), bordered.ptr(border+rows-1-k), rowBytes);
+        }
+    }
+
+    void ORBextractor::AllocatePyramid(const cv::Size& imageSize)
+    {
+        mPyramidImageSize = imageSize;
         for (int level = 0; level < nlevels; ++level)
         {
             float scale = mvInvScaleFactor[level];
-            Size sz(cvRound((float)image.cols*scale), cvRound((float)image.rows*scale));
+            Size sz(cvRound((float)imageSize.width*scale), cvRound((float)imageSize.height*scale));
             Size wholeSize(sz.width + EDGE_THRESHOLD*2, sz.height + EDGE_THRESHOLD*2);
-            Mat temp(wholeSize, image.type()), masktemp;
-            mvImagePyramid[level] = temp(Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
+            mvPyramidBuffers[level].create(wholeSize, CV_8UC1);
+            mvImagePyramid[level] = mvPyramidBuffers[level](Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
+            mvBlurredPyramid[level].create(sz, CV_8UC1);
+        }
+    }
+
+    void ORBextractor::ComputePyramid(cv::Mat image)
+    {
+        // Levels live in buffers allocated for the first image, they are only reallocated if the size changes
+        if(image.size() != mPyramidImageSize)
+            AllocatePyramid(image.size());
+
+        for (int level = 0; level < nlevels; ++level)
+        {
+            Mat& temp = mvPyramidBuffers[level];
 
             // Compute the resized image
             if( level != 0 )
             {
-                resize(mvImagePyramid[level-1], mvImagePyramid[level], sz, 0, 0, INTER_LINEAR);
+                // Written straight into the inner part of the buffer, then the border is reflected around it
+                resize(mvImagePyramid[level-1], mvImagePyramid[level], mvImagePyramid[level].size(), 0, 0, INTER_LINEAR);
 
-                copyMakeBorder(mvImagePyramid[level], temp, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
-                               BORDER_REFLECT_101+BORDER_ISOLATED);
+                if(mvImagePyramid[level].cols > EDGE_THRESHOLD && mvImagePyramid[level].rows > EDGE_THRESHOLD)
+                    fillBorderReflect101(temp, EDGE_THRESHOLD);
+                else
+                    copyMakeBorder(mvImagePyramid[level], temp, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
+                                   BORDER_REFLECT_101+BORDER_ISOLATED);
             }
             else
             {
@@ -26,6 +26,13 @@
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
 
 #include<stdint-gcc.h>
+#include<cstring>
+#include<algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ORBMATCHER_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -40,176 +47,290 @@ namespace ORB_SLAM3
     {
     }
 
-    int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th, const bool bFarPoints, const float thFarPoints)
+    int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th, const bool bFarPoints, const float thFarPoints, ThreadPool* pPool)
     {
-        int nmatches=0, left = 0, right = 0;
+        if(pPool && pPool->GetNumThreads()>0 && vpMapPoints.size()>1)
+            return SearchByProjectionParallel(F,vpMapPoints,th,bFarPoints,thFarPoints,pPool);
 
-        const bool bFactor = th!=1.0;
+        int nmatches=0;
+
+        // Keypoints that can be matched and their distances to the MapPoint descriptor
+        vector<int> vCandidates;
+        vector<int> vDistances;
+        int vSlots[4];
 
         for(size_t iMP=0; iMP<vpMapPoints.size(); iMP++)
         {
             MapPoint* pMP = vpMapPoints[iMP];
-            if(!pMP->mbTrackInView && !pMP->mbTrackInViewR)
-                continue;
+            const int nSlots = MatchLocalMapPoint(F,pMP,th,bFarPoints,thFarPoints,vCandidates,vDistances,NULL,vSlots);
+            for(int i=0; i<nSlots; i++)
+                F.mvpMapPoints[vSlots[i]]=pMP;
+            nmatches+=nSlots;
+        }
+        return nmatches;
+    }
 
-            if(bFarPoints && pMP->mTrackDepth>thFarPoints)
-                continue;
+    int ORBmatcher::SearchByProjectionParallel(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th, const bool bFarPoints, const float thFarPoints, ThreadPool* pPool)
+    {
+        // Each chunk of MapPoints is matched against the frame as it was at the beginning of the search.
+        // Results are kept in the buffers of the chunk together with the keypoints each MapPoint looked at.
+        struct Chunk
+        {
+            vector<int> vCandidates;
+            vector<int> vDistances;
+            vector<size_t> vArea;
+            vector<size_t> vAreaEnd;
+            vector<int> vSlots;
+            vector<int> vnSlots;
+        };
 
-            if(pMP->isBad())
-                continue;
+        const int nMPs = vpMapPoints.size();
+        const int nChunks = min(nMPs, 4*(pPool->GetNumThreads()+1));
+        const int chunkSize = (nMPs+nChunks-1)/nChunks;
+        vector<Chunk> vChunks(nChunks);
 
-            if(pMP->mbTrackInView)
+        pPool->ParallelFor(nChunks, [&](int c)
+        {
+            Chunk &chunk = vChunks[c];
+            const int iEnd = min(nMPs,(c+1)*chunkSize);
+            for(int iMP=c*chunkSize; iMP<iEnd; iMP++)
             {
-                const int &nPredictedLevel = pMP->mnTrackScaleLevel;
+                int vSlots[4];
+                const int nSlots = MatchLocalMapPoint(F,vpMapPoints[iMP],th,bFarPoints,thFarPoints,chunk.vCandidates,chunk.vDistances,&chunk.vArea,vSlots);
+                chunk.vAreaEnd.push_back(chunk.vArea.size());
+                chunk.vSlots.insert(chunk.vSlots.end(),vSlots,vSlots+nSlots);
+                chunk.vnSlots.push_back(nSlots);
+            }
+        });
 
-                // The size of the window will depend on the viewing direction
-                float r = RadiusByViewingCos(pMP->mTrackViewCos);
+        // Merge in MapPoint order. A MapPoint whose search area contains a keypoint taken by a
+        // previous one is matched again against the updated frame, as the serial search would do.
+        int nmatches=0;
+        vector<bool> vbTaken(F.mvpMapPoints.size(),false);
+        vector<int> vCandidates;
+        vector<int> vDistances;
 
-                if(bFactor)
-                    r*=th;
+        for(int c=0; c<nChunks; c++)
+        {
+            const Chunk &chunk = vChunks[c];
+            size_t areaStart = 0;
+            size_t slotStart = 0;
+            for(size_t i=0; i<chunk.vnSlots.size(); i++)
+            {
+                MapPoint* pMP = vpMapPoints[c*chunkSize+i];
 
-                const vector<size_t> vIndices =
-                        F.GetFeaturesInArea(pMP->mTrackProjX,pMP->mTrackProjY,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel);
+                bool bConflict = false;
+                for(size_t k=areaStart; k<chunk.vAreaEnd[i] && !bConflict; k++)
+                    bConflict = vbTaken[chunk.vArea[k]];
 
-                if(!vIndices.empty()){
-                    const cv::Mat MPdescriptor = pMP->GetDescriptor();
+                int vSlots[4];
+                int nSlots = chunk.vnSlots[i];
+                if(bConflict)
+                    nSlots = MatchLocalMapPoint(F,pMP,th,bFarPoints,thFarPoints,vCandidates,vDistances,NULL,vSlots);
+                else
+                    copy(chunk.vSlots.begin()+slotStart,chunk.vSlots.begin()+slotStart+nSlots,vSlots);
 
-                    int bestDist=256;
-                    int bestLevel= -1;
-                    int bestDist2=256;
-                    int bestLevel2 = -1;
-                    int bestIdx =-1 ;
+                for(int j=0; j<nSlots; j++)
+                {
+                    F.mvpMapPoints[vSlots[j]]=pMP;
+                    vbTaken[vSlots[j]]=true;
+                }
+                nmatches+=nSlots;
 
-                    // Get best and second matches with near keypoints
-                    for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-                    {
-                        const size_t idx = *vit;
+                areaStart = chunk.vAreaEnd[i];
+                slotStart += chunk.vnSlots[i];
+            }
+        }
 
-                        if(F.mvpMapPoints[idx])
-                            if(F.mvpMapPoints[idx]->Observations()>0)
-                                continue;
+        return nmatches;
+    }
 
-                        if(F.Nleft == -1 && F.mvuRight[idx]>0)
-                        {
-                            const float er = fabs(pMP->mTrackProjXR-F.mvuRight[idx]);
-                            if(er>r*F.mvScaleFactors[nPredictedLevel])
-                                continue;
-                        }
+    int ORBmatcher::MatchLocalMapPoint(const Frame &F, MapPoint* pMP, const float th, const bool bFarPoints, const float thFarPoints,
+                                       vector<int> &vCandidates, vector<int> &vDistances, vector<size_t>* pvArea, int* pSlots)
+    {
+        int nSlots = 0;
 
-                        const cv::Mat &d = F.mDescriptors.row(idx);
+        if(!pMP->mbTrackInView && !pMP->mbTrackInViewR)
+            return 0;
 
-                        const int dist = DescriptorDistance(MPdescriptor,d);
+        if(bFarPoints && pMP->mTrackDepth>thFarPoints)
+            return 0;
 
-                        if(dist<bestDist)
-                        {
-                            bestDist2=bestDist;
-                            bestDist=dist;
-                            bestLevel2 = bestLevel;
-                            bestLevel = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
-                                                        : (idx < F.Nleft) ? F.mvKeys[idx].octave
-                                                                          : F.mvKeysRight[idx - F.Nleft].octave;
-                            bestIdx=idx;
-                        }
-                        else if(dist<bestDist2)
-                        {
-                            bestLevel2 = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
-                                                         : (idx < F.Nleft) ? F.mvKeys[idx].octave
-                                                                           : F.mvKeysRight[idx - F.Nleft].octave;
-                            bestDist2=dist;
-                        }
-                    }
+        if(pMP->isBad())
+            return 0;
 
-                    // Apply ratio to second match (only if best and second are in the same scale level)
-                    if(bestDist<=TH_HIGH)
+        const bool bFactor = th!=1.0;
+
+        if(pMP->mbTrackInView)
+        {
+            const int &nPredictedLevel = pMP->mnTrackScaleLevel;
+
+            // The size of the window will depend on the viewing direction
+            float r = RadiusByViewingCos(pMP->mTrackViewCos);
+
+            if(bFactor)
+                r*=th;
+
+            const vector<size_t> vIndices =
+                    F.GetFeaturesInArea(pMP->mTrackProjX,pMP->mTrackProjY,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel);
+
+            if(pvArea)
+                pvArea->insert(pvArea->end(),vIndices.begin(),vIndices.end());
+
+            if(!vIndices.empty()){
+                const cv::Mat MPdescriptor = pMP->GetDescriptor();
+
+                vCandidates.clear();
+                for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+                {
+                    const size_t idx = *vit;
+
+                    if(F.mvpMapPoints[idx])
+                        if(F.mvpMapPoints[idx]->Observations()>0)
+                            continue;
+
+                    if(F.Nleft == -1 && F.mvuRight[idx]>0)
                     {
-                        if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
+                        const float er = fabs(pMP->mTrackProjXR-F.mvuRight[idx]);
+                        if(er>r*F.mvScaleFactors[nPredictedLevel])
                             continue;
+                    }
 
-                        if(bestLevel!=bestLevel2 || bestDist<=mfNNratio*bestDist2){
-                            F.mvpMapPoints[bestIdx]=pMP;
+                    vCandidates.push_back(idx);
+                }
 
-                            if(F.Nleft != -1 && F.mvLeftToRightMatch[bestIdx] != -1){ //Also match with the stereo observation at right camera
-                                F.mvpMapPoints[F.mvLeftToRightMatch[bestIdx] + F.Nleft] = pMP;
-                                nmatches++;
-                                right++;
-                            }
+                vDistances.resize(vCandidates.size());
+                DescriptorDistances(MPdescriptor.ptr(),F.mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                            nmatches++;
-                            left++;
+                int bestDist=256;
+                int bestLevel= -1;
+                int bestDist2=256;
+                int bestLevel2 = -1;
+                int bestIdx =-1 ;
+
+                // Get best and second matches with near keypoints
+                for(size_t k=0; k<vCandidates.size(); k++)
+                {
+                    const size_t idx = vCandidates[k];
+                    const int dist = vDistances[k];
+
+                    if(dist<bestDist)
+                    {
+                        bestDist2=bestDist;
+                        bestDist=dist;
+                        bestLevel2 = bestLevel;
+                        bestLevel = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
+                                                    : (idx < F.Nleft) ? F.mvKeys[idx].octave
+                                                                      : F.mvKeysRight[idx - F.Nleft].octave;
+                        bestIdx=idx;
+                    }
+                    else if(dist<bestDist2)
+                    {
+                        bestLevel2 = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
+                                                     : (idx < F.Nleft) ? F.mvKeys[idx].octave
+                                                                       : F.mvKeysRight[idx - F.Nleft].octave;
+                        bestDist2=dist;
+                    }
+                }
+
+                // Apply ratio to second match (only if best and second are in the same scale level)
+                if(bestDist<=TH_HIGH)
+                {
+                    if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
+                        return 0;
+
+                    if(bestLevel!=bestLevel2 || bestDist<=mfNNratio*bestDist2){
+                        pSlots[nSlots++]=bestIdx;
+
+                        if(F.Nleft != -1 && F.mvLeftToRightMatch[bestIdx] != -1){ //Also match with the stereo observation at right camera
+                            pSlots[nSlots++]=F.mvLeftToRightMatch[bestIdx] + F.Nleft;
                         }
                     }
                 }
             }
+        }
 
-            if(F.Nleft != -1 && pMP->mbTrackInViewR){
-                const int &nPredictedLevel = pMP->mnTrackScaleLevelR;
-                if(nPredictedLevel != -1){
-                    float r = RadiusByViewingCos(pMP->mTrackViewCosR);
+        if(F.Nleft != -1 && pMP->mbTrackInViewR){
+            const int &nPredictedLevel = pMP->mnTrackScaleLevelR;
+            if(nPredictedLevel != -1){
+                float r = RadiusByViewingCos(pMP->mTrackViewCosR);
 
-                    const vector<size_t> vIndices =
-                            F.GetFeaturesInArea(pMP->mTrackProjXR,pMP->mTrackProjYR,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel,true);
+                const vector<size_t> vIndices =
+                        F.GetFeaturesInArea(pMP->mTrackProjXR,pMP->mTrackProjYR,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel,true);
 
-                    if(vIndices.empty())
-                        continue;
+                if(pvArea)
+                    for(size_t i=0; i<vIndices.size(); i++)
+                        pvArea->push_back(vIndices[i] + F.Nleft);
 
-                    const cv::Mat MPdescriptor = pMP->GetDescriptor();
+                if(vIndices.empty())
+                    return nSlots;
 
-                    int bestDist=256;
-                    int bestLevel= -1;
-                    int bestDist2=256;
-                    int bestLevel2 = -1;
-                    int bestIdx =-1 ;
+                const cv::Mat MPdescriptor = pMP->GetDescriptor();
 
-                    // Get best and second matches with near keypoints
-                    for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-                    {
-                        const size_t idx = *vit;
+                // Right keypoints are stored after the left ones in the descriptors
+                vCandidates.clear();
+                for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+                {
+                    const size_t idx = *vit;
 
-                        if(F.mvpMapPoints[idx + F.Nleft])
-                            if(F.mvpMapPoints[idx + F.Nleft]->Observations()>0)
-                                continue;
+                    // The keypoints taken above by this same MapPoint are not written in the frame yet
+                    MapPoint* pMPi = F.mvpMapPoints[idx + F.Nleft];
+                    if(find(pSlots,pSlots+nSlots,(int)(idx + F.Nleft))!=pSlots+nSlots)
+                        pMPi = pMP;
+
+                    if(pMPi)
+                        if(pMPi->Observations()>0)
+                            continue;
 
+                    vCandidates.push_back(idx + F.Nleft);
+                }
 
-                        const cv::Mat &d = F.mDescriptors.row(idx + F.Nleft);
+                vDistances.resize(vCandidates.size());
+                DescriptorDistances(MPdescriptor.ptr(),F.mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                        const int dist = DescriptorDistance(MPdescriptor,d);
+                int bestDist=256;
+                int bestLevel= -1;
+                int bestDist2=256;
+                int bestLevel2 = -1;
+                int bestIdx =-1 ;
 
-                        if(dist<bestDist)
-                        {
-                            bestDist2=bestDist;
-                            bestDist=dist;
-                            bestLevel2 = bestLevel;
-                            bestLevel = F.mvKeysRight[idx].octave;
-                            bestIdx=idx;
-                        }
-                        else if(dist<bestDist2)
-                        {
-                            bestLevel2 = F.mvKeysRight[idx].octave;
-                            bestDist2=dist;
-                        }
-                    }
+                // Get best and second matches with near keypoints
+                for(size_t k=0; k<vCandidates.size(); k++)
+                {
+                    const size_t idx = vCandidates[k] - F.Nleft;
+                    const int dist = vDistances[k];
 
-                    // Apply ratio to second match (only if best and second are in the same scale level)
-                    if(bestDist<=TH_HIGH)
+                    if(dist<bestDist)
                     {
-                        if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
-                            continue;
-
-                        if(F.Nleft != -1 && F.mvRightToLeftMatch[bestIdx] != -1){ //Also match with the stereo observation at right camera
-                            F.mvpMapPoints[F.mvRightToLeftMatch[bestIdx]] = pMP;
-                            nmatches++;
-                            left++;
-                        }
+                        bestDist2=bestDist;
+                        bestDist=dist;
+                        bestLevel2 = bestLevel;
+                        bestLevel = F.mvKeysRight[idx].octave;
+                        bestIdx=idx;
+                    }
+                    else if(dist<bestDist2)
+                    {
+                        bestLevel2 = F.mvKeysRight[idx].octave;
+                        bestDist2=dist;
+                    }
+                }
 
+                // Apply ratio to second match (only if best and second are in the same scale level)
+                if(bestDist<=TH_HIGH)
+                {
+                    if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
+                        return nSlots;
 
-                        F.mvpMapPoints[bestIdx + F.Nleft]=pMP;
-                        nmatches++;
-                        right++;
+                    if(F.Nleft != -1 && F.mvRightToLeftMatch[bestIdx] != -1){ //Also match with the stereo observation at right camera
+                        pSlots[nSlots++]=F.mvRightToLeftMatch[bestIdx];
                     }
+
+                    pSlots[nSlots++]=bestIdx + F.Nleft;
                 }
             }
         }
-        return nmatches;
+
+        return nSlots;
     }
 
     float ORBmatcher::RadiusByViewingCos(const float &viewCos)
@@ -235,6 +356,9 @@ namespace ORB_SLAM3
             rotHist[i].reserve(500);
         const float factor = 1.0f/HISTO_LENGTH;
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         // We perform the matching over ORB that belong to the same vocabulary node (at a certain level)
         DBoW2::FeatureVector::const_iterator KFit = vFeatVecKF.begin();
         DBoW2::FeatureVector::const_iterator Fit = F.mFeatVec.begin();
@@ -260,7 +384,20 @@ namespace ORB_SLAM3
                     if(pMP->isBad())
                         continue;
 
-                    const cv::Mat &dKF= pKF->mDescriptors.row(realIdxKF);
+                    // Frame keypoints of the node not matched yet
+                    vCandidates.clear();
+                    for(size_t iF=0; iF<vIndicesF.size(); iF++)
+                    {
+                        const unsigned int realIdxF = vIndicesF[iF];
+
+                        if(vpMapPointMatches[realIdxF])
+                            continue;
+
+                        vCandidates.push_back(realIdxF);
+                    }
+
+                    vDistances.resize(vCandidates.size());
+                    DescriptorDistances(pKF->mDescriptors.ptr(realIdxKF),F.mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
                     int bestDist1=256;
                     int bestIdxF =-1 ;
@@ -270,18 +407,12 @@ namespace ORB_SLAM3
                     int bestIdxFR =-1 ;
                     int bestDist2R=256;
 
-                    for(size_t iF=0; iF<vIndicesF.size(); iF++)
+                    for(size_t k=0; k<vCandidates.size(); k++)
                     {
-                        if(F.Nleft == -1){
-                            const unsigned int realIdxF = vIndicesF[iF];
-
-                            if(vpMapPointMatches[realIdxF])
-                                continue;
-
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                            const int dist =  DescriptorDistance(dKF,dF);
+                        const unsigned int realIdxF = vCandidates[k];
+                        const int dist = vDistances[k];
 
+                        if(F.Nleft == -1){
                             if(dist<bestDist1)
                             {
                                 bestDist2=bestDist1;
@@ -294,15 +425,6 @@ namespace ORB_SLAM3
                             }
                         }
                         else{
-                            const unsigned int realIdxF = vIndicesF[iF];
-
-                            if(vpMapPointMatches[realIdxF])
-                                continue;
-
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                            const int dist =  DescriptorDistance(dKF,dF);
-
                             if(realIdxF < F.Nleft && dist<bestDist1){
                                 bestDist2=bestDist1;
                                 bestDist1=dist;
@@ -442,6 +564,9 @@ namespace ORB_SLAM3
 
         int nmatches=0;
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         // For each Candidate MapPoint Project and Match
         for(int iMP=0, iendMP=vpPoints.size(); iMP<iendMP; iMP++)
         {
@@ -496,8 +621,7 @@ namespace ORB_SLAM3
             // Match to the most similar keypoint in the radius
             const cv::Mat dMP = pMP->GetDescriptor();
 
-            int bestDist = 256;
-            int bestIdx = -1;
+            vCandidates.clear();
             for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
             {
                 const size_t idx = *vit;
@@ -509,9 +633,18 @@ namespace ORB_SLAM3
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            vDistances.resize(vCandidates.size());
+            DescriptorDistances(dMP.ptr(),pKF->mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
+
+            int bestDist = 256;
+            int bestIdx = -1;
+            for(size_t k=0; k<vCandidates.size(); k++)
+            {
+                const size_t idx = vCandidates[k];
+                const int dist = vDistances[k];
 
                 if(dist<bestDist)
                 {
@@ -549,6 +682,9 @@ namespace ORB_SLAM3
 
         int nmatches=0;
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         // For each Candidate MapPoint Project and Match
         for(int iMP=0, iendMP=vpPoints.size(); iMP<iendMP; iMP++)
         {
@@ -609,8 +745,7 @@ namespace ORB_SLAM3
             // Match to the most similar keypoint in the radius
             const cv::Mat dMP = pMP->GetDescriptor();
 
-            int bestDist = 256;
-            int bestIdx = -1;
+            vCandidates.clear();
             for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
             {
                 const size_t idx = *vit;
@@ -622,9 +757,18 @@ namespace ORB_SLAM3
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
+
+            vDistances.resize(vCandidates.size());
+            DescriptorDistances(dMP.ptr(),pKF->mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            int bestDist = 256;
+            int bestIdx = -1;
+            for(size_t k=0; k<vCandidates.size(); k++)
+            {
+                const size_t idx = vCandidates[k];
+                const int dist = vDistances[k];
 
                 if(dist<bestDist)
                 {
@@ -658,6 +802,9 @@ namespace ORB_SLAM3
         vector<int> vMatchedDistance(F2.mvKeysUn.size(),INT_MAX);
         vector<int> vnMatches21(F2.mvKeysUn.size(),-1);
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         for(size_t i1=0, iend1=F1.mvKeysUn.size(); i1<iend1; i1++)
         {
             cv::KeyPoint kp1 = F1.mvKeysUn[i1];
@@ -670,19 +817,19 @@ namespace ORB_SLAM3
             if(vIndices2.empty())
                 continue;
 
-            cv::Mat d1 = F1.mDescriptors.row(i1);
+            vCandidates.assign(vIndices2.begin(),vIndices2.end());
+            vDistances.resize(vCandidates.size());
+            DescriptorDistances(F1.mDescriptors.ptr(i1),F2.mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
             int bestDist = INT_MAX;
             int bestDist2 = INT_MAX;
             int bestIdx2 = -1;
 
-            for(vector<size_t>::iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+            for(size_t k=0; k<vCandidates.size(); k++)
             {
-                size_t i2 = *vit;
-
-                cv::Mat d2 = F2.mDescriptors.row(i2);
+                size_t i2 = vCandidates[k];
 
-                int dist = DescriptorDistance(d1,d2);
+                int dist = vDistances[k];
 
                 if(vMatchedDistance[i2]<=dist)
                     continue;
@@ -785,6 +932,9 @@ namespace ORB_SLAM3
 
         int nmatches = 0;
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         DBoW2::FeatureVector::const_iterator f1it = vFeatVec1.begin();
         DBoW2::FeatureVector::const_iterator f2it = vFeatVec2.begin();
         DBoW2::FeatureVector::const_iterator f1end = vFeatVec1.end();
@@ -807,12 +957,7 @@ namespace ORB_SLAM3
                     if(pMP1->isBad())
                         continue;
 
-                    const cv::Mat &d1 = Descriptors1.row(idx1);
-
-                    int bestDist1=256;
-                    int bestIdx2 =-1 ;
-                    int bestDist2=256;
-
+                    vCandidates.clear();
                     for(size_t i2=0, iend2=f2it->second.size(); i2<iend2; i2++)
                     {
                         const size_t idx2 = f2it->second[i2];
@@ -829,9 +974,20 @@ namespace ORB_SLAM3
                         if(pMP2->isBad())
                             continue;
 
-                        const cv::Mat &d2 = Descriptors2.row(idx2);
+                        vCandidates.push_back(idx2);
+                    }
+
+                    vDistances.resize(vCandidates.size());
+                    DescriptorDistances(Descriptors1.ptr(idx1),Descriptors2,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                        int dist = DescriptorDistance(d1,d2);
+                    int bestDist1=256;
+                    int bestIdx2 =-1 ;
+                    int bestDist2=256;
+
+                    for(size_t k=0; k<vCandidates.size(); k++)
+                    {
+                        const size_t idx2 = vCandidates[k];
+                        int dist = vDistances[k];
 
                         if(dist<bestDist1)
                         {
@@ -945,8 +1101,15 @@ namespace ORB_SLAM3
         // Find matches between not tracked keypoints
         // Matching speed-up by ORB Vocabulary
         // Compare only ORB that share the same node
+        // MapPoints of both keyframes are read once instead of locking them for every keypoint
+        const vector<MapPoint*> vpMapPoints1 = pKF1->GetMapPointMatches();
+        const vector<MapPoint*> vpMapPoints2 = pKF2->GetMapPointMatches();
+
         int nmatches=0;
         vector<bool> vbMatched2(pKF2->N,false);
+
+        vector<int> vCandidates;
+        vector<int> vDistances;
         vector<int> vMatches12(pKF1->N,-1);
 
         vector<int> rotHist[HISTO_LENGTH];
@@ -968,7 +1131,7 @@ namespace ORB_SLAM3
                 {
                     const size_t idx1 = f1it->second[i1];
 
-                    MapPoint* pMP1 = pKF1->GetMapPoint(idx1);
+                    MapPoint* pMP1 = vpMapPoints1[idx1];
 
                     // If there is already a MapPoint skip
                     if(pMP1)
@@ -989,16 +1152,12 @@ namespace ORB_SLAM3
                     const bool bRight1 = (pKF1 -> NLeft == -1 || idx1 < pKF1 -> NLeft) ? false
                                                                                        : true;
 
-                    const cv::Mat &d1 = pKF1->mDescriptors.row(idx1);
-
-                    int bestDist = TH_LOW;
-                    int bestIdx2 = -1;
-
+                    vCandidates.clear();
                     for(size_t i2=0, iend2=f2it->second.size(); i2<iend2; i2++)
                     {
                         size_t idx2 = f2it->second[i2];
 
-                        MapPoint* pMP2 = pKF2->GetMapPoint(idx2);
+                        MapPoint* pMP2 = vpMapPoints2[idx2];
 
                         // If we have already matched or there is a MapPoint skip
                         if(vbMatched2[idx2] || pMP2)
@@ -1010,9 +1169,21 @@ namespace ORB_SLAM3
                             if(!bStereo2)
                                 continue;
 
-                        const cv::Mat &d2 = pKF2->mDescriptors.row(idx2);
+                        vCandidates.push_back(idx2);
+                    }
 
-                        const int dist = DescriptorDistance(d1,d2);
+                    vDistances.resize(vCandidates.size());
+                    DescriptorDistances(pKF1->mDescriptors.ptr(idx1),pKF2->mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
+
+                    int bestDist = TH_LOW;
+                    int bestIdx2 = -1;
+
+                    for(size_t k=0; k<vCandidates.size(); k++)
+                    {
+                        size_t idx2 = vCandidates[k];
+                        const int dist = vDistances[k];
+
+                        const bool bStereo2 = (!pKF2->mpCamera2 &&  pKF2->mvuRight[idx2]>=0);
 
                         if(dist>TH_LOW || dist>bestDist)
                             continue;
@@ -1172,6 +1343,9 @@ namespace ORB_SLAM3
 
         const int nMPs = vpMapPoints.size();
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         // For debbuging
         int count_notMP = 0, count_bad=0, count_isinKF = 0, count_negdepth = 0, count_notinim = 0, count_dist = 0, count_normal=0, count_notidx = 0, count_thcheck = 0;
         for(int i=0; i<nMPs; i++)
@@ -1255,8 +1429,7 @@ namespace ORB_SLAM3
 
             const cv::Mat dMP = pMP->GetDescriptor();
 
-            int bestDist = 256;
-            int bestIdx = -1;
+            vCandidates.clear();
             for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
             {
                 size_t idx = *vit;
@@ -1297,9 +1470,18 @@ namespace ORB_SLAM3
 
                 if(bRight) idx += pKF->NLeft;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
+
+            vDistances.resize(vCandidates.size());
+            DescriptorDistances(dMP.ptr(),pKF->mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            int bestDist = 256;
+            int bestIdx = -1;
+            for(size_t k=0; k<vCandidates.size(); k++)
+            {
+                const size_t idx = vCandidates[k];
+                const int dist = vDistances[k];
 
                 if(dist<bestDist)
                 {
@@ -1356,6 +1538,9 @@ namespace ORB_SLAM3
 
         const int nPoints = vpPoints.size();
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         // For each candidate MapPoint project and match
         for(int iMP=0; iMP<nPoints; iMP++)
         {
@@ -1412,8 +1597,7 @@ namespace ORB_SLAM3
 
             const cv::Mat dMP = pMP->GetDescriptor();
 
-            int bestDist = INT_MAX;
-            int bestIdx = -1;
+            vCandidates.clear();
             for(vector<size_t>::const_iterator vit=vIndices.begin(); vit!=vIndices.end(); vit++)
             {
                 const size_t idx = *vit;
@@ -1422,9 +1606,18 @@ namespace ORB_SLAM3
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
+
+            vDistances.resize(vCandidates.size());
+            DescriptorDistances(dMP.ptr(),pKF->mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                int dist = DescriptorDistance(dMP,dKF);
+            int bestDist = INT_MAX;
+            int bestIdx = -1;
+            for(size_t k=0; k<vCandidates.size(); k++)
+            {
+                const size_t idx = vCandidates[k];
+                int dist = vDistances[k];
 
                 if(dist<bestDist)
                 {
@@ -1492,6 +1685,9 @@ namespace ORB_SLAM3
         vector<int> vnMatch1(N1,-1);
         vector<int> vnMatch2(N2,-1);
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         // Transform from KF1 to KF2 and search
         for(int i1=0; i1<N1; i1++)
         {
@@ -1544,8 +1740,7 @@ namespace ORB_SLAM3
             // Match to the most similar keypoint in the radius
             const cv::Mat dMP = pMP->GetDescriptor();
 
-            int bestDist = INT_MAX;
-            int bestIdx = -1;
+            vCandidates.clear();
             for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
             {
                 const size_t idx = *vit;
@@ -1555,9 +1750,18 @@ namespace ORB_SLAM3
                 if(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF2->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
+
+            vDistances.resize(vCandidates.size());
+            DescriptorDistances(dMP.ptr(),pKF2->mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            int bestDist = INT_MAX;
+            int bestIdx = -1;
+            for(size_t k=0; k<vCandidates.size(); k++)
+            {
+                const size_t idx = vCandidates[k];
+                const int dist = vDistances[k];
 
                 if(dist<bestDist)
                 {
@@ -1624,8 +1828,7 @@ namespace ORB_SLAM3
             // Match to the most similar keypoint in the radius
             const cv::Mat dMP = pMP->GetDescriptor();
 
-            int bestDist = INT_MAX;
-            int bestIdx = -1;
+            vCandidates.clear();
             for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
             {
                 const size_t idx = *vit;
@@ -1635,9 +1838,18 @@ namespace ORB_SLAM3
                 if(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF1->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
+
+            vDistances.resize(vCandidates.size());
+            DescriptorDistances(dMP.ptr(),pKF1->mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            int bestDist = INT_MAX;
+            int bestIdx = -1;
+            for(size_t k=0; k<vCandidates.size(); k++)
+            {
+                const size_t idx = vCandidates[k];
+                const int dist = vDistances[k];
 
                 if(dist<bestDist)
                 {
@@ -1677,6 +1889,9 @@ namespace ORB_SLAM3
     {
         int nmatches = 0;
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         // Rotation Histogram (to check rotation consistency)
         vector<int> rotHist[HISTO_LENGTH];
         for(int i=0;i<HISTO_LENGTH;i++)
@@ -1692,6 +1907,22 @@ namespace ORB_SLAM3
         const bool bForward = tlc(2)>CurrentFrame.mb && !bMono;
         const bool bBackward = -tlc(2)>CurrentFrame.mb && !bMono;
 
+        // Project the MapPoints of the last frame in one batch (points without MapPoint are left behind the camera)
+        const int nLast = LastFrame.N;
+        vector<float> vXc(nLast,0.f), vYc(nLast,0.f), vZc(nLast,-1.f), vU(nLast), vV(nLast);
+        for(int i=0; i<nLast; i++)
+        {
+            MapPoint* pMP = LastFrame.mvpMapPoints[i];
+            if(pMP && !LastFrame.mvbOutlier[i])
+            {
+                const Eigen::Vector3f x3Dc = Tcw * pMP->GetWorldPos();
+                vXc[i] = x3Dc(0);
+                vYc[i] = x3Dc(1);
+                vZc[i] = x3Dc(2);
+            }
+        }
+        CurrentFrame.mpCamera->projectBatch(vXc.data(),vYc.data(),vZc.data(),nLast,vU.data(),vV.data());
+
         for(int i=0; i<LastFrame.N; i++)
         {
             MapPoint* pMP = LastFrame.mvpMapPoints[i];
@@ -1699,18 +1930,13 @@ namespace ORB_SLAM3
             {
                 if(!LastFrame.mvbOutlier[i])
                 {
-                    // Project
-                    Eigen::Vector3f x3Dw = pMP->GetWorldPos();
-                    Eigen::Vector3f x3Dc = Tcw * x3Dw;
-
-                    const float xc = x3Dc(0);
-                    const float yc = x3Dc(1);
+                    const Eigen::Vector3f x3Dc(vXc[i],vYc[i],vZc[i]);
                     const float invzc = 1.0/x3Dc(2);
 
                     if(invzc<0)
                         continue;
 
-                    Eigen::Vector2f uv = CurrentFrame.mpCamera->project(x3Dc);
+                    const Eigen::Vector2f uv(vU[i],vV[i]);
 
                     if(uv(0)<CurrentFrame.mnMinX || uv(0)>CurrentFrame.mnMaxX)
                         continue;
@@ -1737,9 +1963,7 @@ namespace ORB_SLAM3
 
                     const cv::Mat dMP = pMP->GetDescriptor();
 
-                    int bestDist = 256;
-                    int bestIdx2 = -1;
-
+                    vCandidates.clear();
                     for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
                     {
                         const size_t i2 = *vit;
@@ -1756,9 +1980,19 @@ namespace ORB_SLAM3
                                 continue;
                         }
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                        vCandidates.push_back(i2);
+                    }
 
-                        const int dist = DescriptorDistance(dMP,d);
+                    vDistances.resize(vCandidates.size());
+                    DescriptorDistances(dMP.ptr(),CurrentFrame.mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
+
+                    int bestDist = 256;
+                    int bestIdx2 = -1;
+
+                    for(size_t k=0; k<vCandidates.size(); k++)
+                    {
+                        const size_t i2 = vCandidates[k];
+                        const int dist = vDistances[k];
 
                         if(dist<bestDist)
                         {
@@ -1812,9 +2046,7 @@ namespace ORB_SLAM3
 
                         const cv::Mat dMP = pMP->GetDescriptor();
 
-                        int bestDist = 256;
-                        int bestIdx2 = -1;
-
+                        vCandidates.clear();
                         for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
                         {
                             const size_t i2 = *vit;
@@ -1822,9 +2054,19 @@ namespace ORB_SLAM3
                                 if(CurrentFrame.mvpMapPoints[i2 + CurrentFrame.Nleft]->Observations()>0)
                                     continue;
 
-                            const cv::Mat &d = CurrentFrame.mDescriptors.row(i2 + CurrentFrame.Nleft);
+                            vCandidates.push_back(i2 + CurrentFrame.Nleft);
+                        }
+
+                        vDistances.resize(vCandidates.size());
+                        DescriptorDistances(dMP.ptr(),CurrentFrame.mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                            const int dist = DescriptorDistance(dMP,d);
+                        int bestDist = 256;
+                        int bestIdx2 = -1;
+
+                        for(size_t k=0; k<vCandidates.size(); k++)
+                        {
+                            const size_t i2 = vCandidates[k] - CurrentFrame.Nleft;
+                            const int dist = vDistances[k];
 
                             if(dist<bestDist)
                             {
@@ -1890,6 +2132,9 @@ namespace ORB_SLAM3
     {
         int nmatches = 0;
 
+        vector<int> vCandidates;
+        vector<int> vDistances;
+
         const Sophus::SE3f Tcw = CurrentFrame.GetPose();
         Eigen::Vector3f Ow = Tcw.inverse().translation();
 
@@ -1943,18 +2188,26 @@ namespace ORB_SLAM3
 
                     const cv::Mat dMP = pMP->GetDescriptor();
 
-                    int bestDist = 256;
-                    int bestIdx2 = -1;
-
+                    vCandidates.clear();
                     for(vector<size_t>::const_iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
                     {
                         const size_t i2 = *vit;
                         if(CurrentFrame.mvpMapPoints[i2])
                             continue;
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                        vCandidates.push_back(i2);
+                    }
+
+                    vDistances.resize(vCandidates.size());
+                    DescriptorDistances(dMP.ptr(),CurrentFrame.mDescriptors,vCandidates.data(),vCandidates.size(),vDistances.data());
 
-                        const int dist = DescriptorDistance(dMP,d);
+                    int bestDist = 256;
+                    int bestIdx2 = -1;
+
+                    for(size_t k=0; k<vCandidates.size(); k++)
+                    {
+                        const size_t i2 = vCandidates[k];
+                        const int dist = vDistances[k];
 
                         if(dist<bestDist)
                         {
@@ -2055,22 +2308,252 @@ namespace ORB_SLAM3
 
 // Bit set count operation from
 // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
-    int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
+    // Bit set count of a 256 bit descriptor xor, four 64 bit words at a time
+    static inline int distanceScalar(const uchar* a, const uchar* b)
     {
-        const int *pa = a.ptr<int32_t>();
-        const int *pb = b.ptr<int32_t>();
+        int dist=0;
+        for(int i=0; i<4; i++)
+        {
+            uint64_t va, vb;
+            memcpy(&va,a+8*i,8);
+            memcpy(&vb,b+8*i,8);
+            uint64_t v = va ^ vb;
+            v = v - ((v >> 1) & 0x5555555555555555ULL);
+            v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+            dist += (int)((((v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * 0x0101010101010101ULL) >> 56);
+        }
+        return dist;
+    }
 
+    static void distancesScalar(const uchar* pQuery, const uchar* pBase, const size_t step, const int* pIdx, const int n, int* pDist)
+    {
+        for(int i=0; i<n; i++)
+            pDist[i] = distanceScalar(pQuery, pBase + (pIdx ? pIdx[i] : i)*step);
+    }
+
+#ifdef ORBMATCHER_X86_DISPATCH
+    __attribute__((target("popcnt")))
+    static inline int distancePOPCNT(const uchar* a, const uchar* b)
+    {
         int dist=0;
+        for(int i=0; i<4; i++)
+        {
+            uint64_t va, vb;
+            memcpy(&va,a+8*i,8);
+            memcpy(&vb,b+8*i,8);
+            dist += __builtin_popcountll(va ^ vb);
+        }
+        return dist;
+    }
+
+    __attribute__((target("popcnt")))
+    static void distancesPOPCNT(const uchar* pQuery, const uchar* pBase, const size_t step, const int* pIdx, const int n, int* pDist)
+    {
+        for(int i=0; i<n; i++)
+            pDist[i] = distancePOPCNT(pQuery, pBase + (pIdx ? pIdx[i] : i)*step);
+    }
 
-        for(int i=0; i<8; i++, pa++, pb++)
+    // Per byte popcount through a nibble table, summed per 64 bit lane
+    __attribute__((target("avx2")))
+    static inline __m256i popcountLanesAVX2(const __m256i x)
+    {
+        const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                             0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+        const __m256i lowMask = _mm256_set1_epi8(0x0f);
+        const __m256i lo = _mm256_shuffle_epi8(lut,_mm256_and_si256(x,lowMask));
+        const __m256i hi = _mm256_shuffle_epi8(lut,_mm256_and_si256(_mm256_srli_epi16(x,4),lowMask));
+        return _mm256_sad_epu8(_mm256_add_epi8(lo,hi),_mm256_setzero_si256());
+    }
+
+    // Sum the four 64 bit lanes of a and b, giving [a, b, a, b] as 32 bit values
+    __attribute__((target("avx2")))
+    static inline __m128i sumLanesAVX2(const __m256i a, const __m256i b)
+    {
+        __m256i ab = _mm256_or_si256(a,_mm256_slli_epi64(b,32));
+        ab = _mm256_add_epi32(ab,_mm256_shuffle_epi32(ab,_MM_SHUFFLE(1,0,3,2)));
+        return _mm_add_epi32(_mm256_castsi256_si128(ab),_mm256_extracti128_si256(ab,1));
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    static void distancesAVX2(const uchar* pQuery, const uchar* pBase, const size_t step, const int* pIdx, const int n, int* pDist)
+    {
+        const __m256i q = _mm256_loadu_si256((const __m256i*)pQuery);
+
+        int i=0;
+        for(; i+4<=n; i+=4)
         {
-            unsigned  int v = *pa ^ *pb;
-            v = v - ((v >> 1) & 0x55555555);
-            v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-            dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+            const uchar* d0 = pBase + (pIdx ? pIdx[i] : i)*step;
+            const uchar* d1 = pBase + (pIdx ? pIdx[i+1] : i+1)*step;
+            const uchar* d2 = pBase + (pIdx ? pIdx[i+2] : i+2)*step;
+            const uchar* d3 = pBase + (pIdx ? pIdx[i+3] : i+3)*step;
+
+            const __m256i c0 = popcountLanesAVX2(_mm256_xor_si256(q,_mm256_loadu_si256((const __m256i*)d0)));
+            const __m256i c1 = popcountLanesAVX2(_mm256_xor_si256(q,_mm256_loadu_si256((const __m256i*)d1)));
+            const __m256i c2 = popcountLanesAVX2(_mm256_xor_si256(q,_mm256_loadu_si256((const __m256i*)d2)));
+            const __m256i c3 = popcountLanesAVX2(_mm256_xor_si256(q,_mm256_loadu_si256((const __m256i*)d3)));
+
+            const __m128i s01 = sumLanesAVX2(c0,c1);
+            const __m128i s23 = sumLanesAVX2(c2,c3);
+            _mm_storeu_si128((__m128i*)(pDist+i),_mm_unpacklo_epi64(s01,s23));
         }
 
-        return dist;
+        for(; i<n; i++)
+            pDist[i] = distancePOPCNT(pQuery, pBase + (pIdx ? pIdx[i] : i)*step);
+    }
+
+    // Two descriptors per register, VPOPCNTQ counts each 64 bit word
+    __attribute__((target("avx512f,avx512vpopcntdq,avx2,popcnt")))
+    static void distancesAVX512(const uchar* pQuery, const uchar* pBase, const size_t step, const int* pIdx, const int n, int* pDist)
+    {
+        const __m512i q = _mm512_broadcast_i64x4(_mm256_loadu_si256((const __m256i*)pQuery));
+        const __m512i sel = _mm512_setr_epi64(0,4,8,12,0,4,8,12);
+
+        int i=0;
+        for(; i+4<=n; i+=4)
+        {
+            const uchar* d0 = pBase + (pIdx ? pIdx[i] : i)*step;
+            const uchar* d1 = pBase + (pIdx ? pIdx[i+1] : i+1)*step;
+            const uchar* d2 = pBase + (pIdx ? pIdx[i+2] : i+2)*step;
+            const uchar* d3 = pBase + (pIdx ? pIdx[i+3] : i+3)*step;
+
+            const __m512i x01 = _mm512_inserti64x4(_mm512_castsi256_si512(_mm256_loadu_si256((const __m256i*)d0)),
+                                                   _mm256_loadu_si256((const __m256i*)d1),1);
+            const __m512i x23 = _mm512_inserti64x4(_mm512_castsi256_si512(_mm256_loadu_si256((const __m256i*)d2)),
+                                                   _mm256_loadu_si256((const __m256i*)d3),1);
+
+            __m512i c01 = _mm512_popcnt_epi64(_mm512_xor_si512(q,x01));
+            __m512i c23 = _mm512_popcnt_epi64(_mm512_xor_si512(q,x23));
+
+            // Sum the four words of each descriptor into its first word
+            c01 = _mm512_add_epi64(c01,_mm512_shuffle_epi32(c01,_MM_PERM_BADC));
+            c23 = _mm512_add_epi64(c23,_mm512_shuffle_epi32(c23,_MM_PERM_BADC));
+            c01 = _mm512_add_epi64(c01,_mm512_shuffle_i64x2(c01,c01,_MM_SHUFFLE(2,3,0,1)));
+            c23 = _mm512_add_epi64(c23,_mm512_shuffle_i64x2(c23,c23,_MM_SHUFFLE(2,3,0,1)));
+
+            const __m512i d = _mm512_permutex2var_epi64(c01,sel,c23);
+            _mm_storeu_si128((__m128i*)(pDist+i),_mm256_castsi256_si128(_mm512_cvtepi64_epi32(d)));
+        }
+
+        for(; i<n; i++)
+            pDist[i] = distancePOPCNT(pQuery, pBase + (pIdx ? pIdx[i] : i)*step);
+    }
+#endif
+
+    typedef void (*DistancesFunction)(const uchar*, const uchar*, const size_t, const int*, const int, int*);
+
+    enum DistanceBackend {DISTANCE_SCALAR=0, DISTANCE_POPCNT=1, DISTANCE_AVX2=2, DISTANCE_AVX512=3};
+
+    static DistanceBackend detectDistanceBackend()
+    {
+#ifdef ORBMATCHER_X86_DISPATCH
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+            return DISTANCE_AVX512;
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+            return DISTANCE_AVX2;
+        if(__builtin_cpu_supports("popcnt"))
+            return DISTANCE_POPCNT;
+#endif
+        return DISTANCE_SCALAR;
+    }
+
+    static DistanceBackend getDistanceBackend()
+    {
+        static const DistanceBackend backend = detectDistanceBackend();
+        return backend;
+    }
+
+    static DistancesFunction getDistancesFunction()
+    {
+        switch(getDistanceBackend())
+        {
+#ifdef ORBMATCHER_X86_DISPATCH
+            case DISTANCE_AVX512:
+                return distancesAVX512;
+            case DISTANCE_AVX2:
+                return distancesAVX2;
+            case DISTANCE_POPCNT:
+                return distancesPOPCNT;
+#endif
+            default:
+                return distancesScalar;
+        }
+    }
+
+    const char* ORBmatcher::GetDistanceBackendName()
+    {
+        switch(getDistanceBackend())
+        {
+            case DISTANCE_AVX512:
+                return "AVX-512 VPOPCNTQ";
+            case DISTANCE_AVX2:
+                return "AVX2";
+            case DISTANCE_POPCNT:
+                return "POPCNT";
+            default:
+                return "scalar";
+        }
+    }
+
+    int ORBmatcher::DescriptorDistance(const uchar* a, const uchar* b)
+    {
+#ifdef ORBMATCHER_X86_DISPATCH
+        static const bool bPOPCNT = getDistanceBackend() != DISTANCE_SCALAR;
+        if(bPOPCNT)
+            return distancePOPCNT(a,b);
+#endif
+        return distanceScalar(a,b);
+    }
+
+    int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
+    {
+        return DescriptorDistance(a.ptr<uchar>(),b.ptr<uchar>());
+    }
+
+    void ORBmatcher::DescriptorDistances(const uchar* pQuery, const cv::Mat &descriptors, const int* pIdx, const int n, int* pDist)
+    {
+        static const DistancesFunction distances = getDistancesFunction();
+        if(n>0)
+            distances(pQuery, descriptors.data, descriptors.step, pIdx, n, pDist);
+    }
+
+    void ORBmatcher::DescriptorDistances(const uchar* pQuery, const uchar* pBlock, const int n, int* pDist)
+    {
+        static const DistancesFunction distances = getDistancesFunction();
+        if(n>0)
+            distances(pQuery, pBlock, 32, NULL, n, pDist);
+    }
+
+    int ORBmatcher::BestDescriptorDistances(const uchar* pQuery, const uchar* pBlock, const int n, int &bestDist, int &bestDist2)
+    {
+        bestDist = 256;
+        bestDist2 = 256;
+        int bestIdx = -1;
+
+        // Distances are computed in chunks that fit on the stack
+        const int CHUNK = 64;
+        int vDist[CHUNK];
+        for(int i0=0; i0<n; i0+=CHUNK)
+        {
+            const int nChunk = min(CHUNK,n-i0);
+            DescriptorDistances(pQuery, pBlock+32*i0, nChunk, vDist);
+            for(int i=0; i<nChunk; i++)
+            {
+                const int dist = vDist[i];
+                if(dist<bestDist)
+                {
+                    bestDist2=bestDist;
+                    bestDist=dist;
+                    bestIdx=i0+i;
+                }
+                else if(dist<bestDist2)
+                {
+                    bestDist2=dist;
+                }
+            }
+        }
+
+        return bestIdx;
     }
 
 } //namespace ORB_SLAM
@@ -22,6 +22,7 @@
 #include "CameraModels/KannalaBrandt8.h"
 
 #include "System.h"
+#include "ORBextractor.h"
 
 #include <opencv2/core/persistence.hpp>
 #include <opencv2/core/eigen.hpp>
@@ -407,6 +408,10 @@ namespace ORB_SLAM3 {
             }
         }
 
+        undistortionLUT_ = readParameter<int>(fSettings,"Camera.undistortionLUT",found,false);
+        if(!found || undistortionLUT_ < 0)
+            undistortionLUT_ = 0;
+
         fps_ = readParameter<int>(fSettings,"Camera.fps",found);
         bRGB_ = (bool) readParameter<int>(fSettings,"Camera.RGB",found);
     }
@@ -448,6 +453,22 @@ namespace ORB_SLAM3 {
         nLevels_ = readParameter<int>(fSettings,"ORBextractor.nLevels",found);
         initThFAST_ = readParameter<int>(fSettings,"ORBextractor.iniThFAST",found);
         minThFAST_ = readParameter<int>(fSettings,"ORBextractor.minThFAST",found);
+
+        nExtractorThreads_ = readParameter<int>(fSettings,"ORBextractor.nThreads",found,false);
+        if(!found || nExtractorThreads_ < 1)
+            nExtractorThreads_ = 1;
+
+        string distributionMethod = readParameter<string>(fSettings,"ORBextractor.DistributionMethod",found,false);
+        if(!found || distributionMethod == "OctTree"){
+            distributionMethod_ = ORBextractor::OCTTREE_DISTRIBUTION;
+        }
+        else if(distributionMethod == "Grid"){
+            distributionMethod_ = ORBextractor::GRID_DISTRIBUTION;
+        }
+        else{
+            cerr << "Error: ORB distribution method " << distributionMethod << " not known" << endl;
+            exit(-1);
+        }
     }
 
     void Settings::readViewer(cv::FileStorage &fSettings) {
@@ -480,6 +501,12 @@ namespace ORB_SLAM3 {
         bool found;
 
         thFarPoints_ = readParameter<float>(fSettings,"System.thFarPoints",found,false);
+
+        nMappingThreads_ = readParameter<int>(fSettings,"LocalMapping.nThreads",found,false);
+        if(!found || nMappingThreads_ < 1)
+            nMappingThreads_ = 1;
+
+        reclaimMemory_ = readParameter<int>(fSettings,"System.ReclaimMemory",found,false) != 0;
     }
 
     void Settings::precomputeRectificationMaps() {
@@ -575,6 +602,8 @@ namespace ORB_SLAM3 {
 
         output << "\t-Original image size: [ " << settings.originalImSize_.width << " , " << settings.originalImSize_.height << " ]" << endl;
         output << "\t-Current image size: [ " << settings.newImSize_.width << " , " << settings.newImSize_.height << " ]" << endl;
+        if(settings.undistortionLUT_ > 0)
+            output << "\t-Undistortion LUT subdivisions per pixel: " << settings.undistortionLUT_ << endl;
 
         if(settings.bNeedToRectify_){
             output << "\t-Camera 1 parameters after rectification: [ ";
@@ -632,6 +661,10 @@ namespace ORB_SLAM3 {
         output << "\t-ORB number of scales: " << settings.nLevels_ << endl;
         output << "\t-Initial FAST threshold: " << settings.initThFAST_ << endl;
         output << "\t-Min FAST threshold: " << settings.minThFAST_ << endl;
+        output << "\t-ORB extraction threads: " << settings.nExtractorThreads_ << endl;
+        output << "\t-ORB keypoint distribution: " << (settings.distributionMethod_ == ORBextractor::GRID_DISTRIBUTION ? "Grid" : "OctTree") << endl;
+        output << "\t-Local mapping threads: " << settings.nMappingThreads_ << endl;
+        output << "\t-Release culled keyframes and points: " << (settings.reclaimMemory_ ? "yes" : "no") << endl;
 
         return output;
     }
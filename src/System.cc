@@ -193,9 +193,37 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     mpTracker = new Tracking(this, mpVocabulary, mpFrameDrawer, mpMapDrawer,
                              mpAtlas, mpKeyFrameDatabase, strSettingsFile, mSensor, settings_, strSequence);
 
+    //Initialize the ORB extraction workers. The tracking thread takes part in the work, stereo
+    //needs at least one worker to extract both images at the same time
+    int nExtractorWorkers = mpTracker->GetExtractorThreads()-1;
+    if(mSensor==STEREO || mSensor==IMU_STEREO)
+        nExtractorWorkers = max(nExtractorWorkers,1);
+    mpExtractorPool = new ThreadPool(nExtractorWorkers);
+    mpTracker->SetExtractorPool(mpExtractorPool);
+
+    //Deferred release of the culled keyframes and map points
+    bool bReclaimMemory = false;
+    if(settings_)
+        bReclaimMemory = settings_->reclaimMemory();
+    else
+    {
+        cv::FileNode nodeReclaim = fsSettings["System.ReclaimMemory"];
+        if(!nodeReclaim.empty() && nodeReclaim.isInt())
+            bReclaimMemory = nodeReclaim.operator int() != 0;
+    }
+    mpEpochManager = NULL;
+    if(bReclaimMemory)
+    {
+        mpEpochManager = new EpochManager();
+        MapPoint::mpEpochManager = mpEpochManager;
+        KeyFrame::mpEpochManager = mpEpochManager;
+        mpTracker->SetEpochManager(mpEpochManager);
+    }
+
     //Initialize the Local Mapping thread and launch
     mpLocalMapper = new LocalMapping(this, mpAtlas, mSensor==MONOCULAR || mSensor==IMU_MONOCULAR,
                                      mSensor==IMU_MONOCULAR || mSensor==IMU_STEREO || mSensor==IMU_RGBD, strSequence);
+    mpLocalMapper->SetEpochManager(mpEpochManager);
     mptLocalMapping = new thread(&ORB_SLAM3::LocalMapping::Run,mpLocalMapper);
     mpLocalMapper->mInitFr = initFr;
     if(settings_)
@@ -210,9 +238,23 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     else
         mpLocalMapper->mbFarPoints = false;
 
+    //Initialize the triangulation workers. The local mapping thread takes part in the work
+    int nMappingThreads = 1;
+    if(settings_)
+        nMappingThreads = settings_->nMappingThreads();
+    else
+    {
+        cv::FileNode nodeThreads = fsSettings["LocalMapping.nThreads"];
+        if(!nodeThreads.empty() && nodeThreads.isInt())
+            nMappingThreads = max(nodeThreads.operator int(),1);
+    }
+    mpMappingPool = new ThreadPool(nMappingThreads-1);
+    mpLocalMapper->SetThreadPool(nMappingThreads>1 ? mpMappingPool : NULL);
+
     //Initialize the Loop Closing thread and launch
     // mSensor!=MONOCULAR && mSensor!=IMU_MONOCULAR
     mpLoopCloser = new LoopClosing(mpAtlas, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR, activeLC); // mSensor!=MONOCULAR);
+    mpLoopCloser->SetEpochManager(mpEpochManager);
     mptLoopClosing = new thread(&ORB_SLAM3::LoopClosing::Run, mpLoopCloser);
 
     //Set pointers between threads
@@ -232,6 +274,7 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     //if(false) // TODO
     {
         mpViewer = new Viewer(this, mpFrameDrawer,mpMapDrawer,mpTracker,strSettingsFile,settings_);
+        mpViewer->SetEpochManager(mpEpochManager);
         mptViewer = new thread(&Viewer::Run, mpViewer);
         mpTracker->SetViewer(mpViewer);
         mpLoopCloser->mpViewer = mpViewer;
@@ -637,7 +680,22 @@ void System::Shutdown()
     mpTracker->PrintTimeStats();
 #endif
 
+    mpTracker->SetExtractorPool(NULL);
+    delete mpExtractorPool;
+    mpExtractorPool = NULL;
 
+    // The local mapper may still be triangulating on the pool
+    while(!mpLocalMapper->isFinished())
+        usleep(5000);
+    mpLocalMapper->SetThreadPool(NULL);
+    delete mpMappingPool;
+    mpMappingPool = NULL;
+
+    if(mpEpochManager)
+    {
+        cout << "Released memory of culled keyframes and points: " << mpEpochManager->GetReclaimedBytes()/1024 << " KB, "
+             << mpEpochManager->GetPendingObjects() << " objects pending" << endl;
+    }
 }
 
 bool System::isShutDown() {
@@ -0,0 +1,168 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+
+namespace ORB_SLAM3
+{
+
+ThreadPool::ThreadPool(const int nThreads): mbStop(false)
+{
+    for(int i=0; i<nThreads; i++)
+        mvThreads.push_back(std::thread(&ThreadPool::Run,this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutexJobs);
+        mbStop = true;
+    }
+    mcvJobs.notify_all();
+
+    for(size_t i=0; i<mvThreads.size(); i++)
+        mvThreads[i].join();
+}
+
+int ThreadPool::GetNumThreads() const
+{
+    return mvThreads.size();
+}
+
+void ThreadPool::Run()
+{
+    while(1)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mMutexJobs);
+            mcvJobs.wait(lock, [this]{return mbStop || !mlJobs.empty();});
+
+            if(mlJobs.empty())
+                return;
+
+            job = std::move(mlJobs.front());
+            mlJobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+std::future<void> ThreadPool::Submit(const std::function<void()> &f, double* pTime)
+{
+    std::shared_ptr<std::packaged_task<void()> > pTask;
+    if(pTime)
+    {
+        pTask = std::make_shared<std::packaged_task<void()> >([f,pTime]()
+        {
+            std::chrono::steady_clock::time_point time_Start = std::chrono::steady_clock::now();
+            f();
+            std::chrono::steady_clock::time_point time_End = std::chrono::steady_clock::now();
+            *pTime = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_End - time_Start).count();
+        });
+    }
+    else
+        pTask = std::make_shared<std::packaged_task<void()> >(f);
+    std::future<void> result = pTask->get_future();
+
+    if(mvThreads.empty())
+    {
+        (*pTask)();
+        return result;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mMutexJobs);
+        mlJobs.push_back([pTask]{(*pTask)();});
+    }
+    mcvJobs.notify_one();
+
+    return result;
+}
+
+void ThreadPool::ParallelFor(const int n, const std::function<void(int)> &f)
+{
+    if(n<=0)
+        return;
+
+    if(mvThreads.empty() || n==1)
+    {
+        for(int i=0; i<n; i++)
+            f(i);
+        return;
+    }
+
+    // Iterations are claimed one by one by the caller and the helper jobs. Helpers that start
+    // once all iterations are claimed return without touching f.
+    struct Loop
+    {
+        const std::function<void(int)>* pf;
+        int n;
+        std::atomic<int> next;
+        std::atomic<int> nDone;
+        std::mutex mMutex;
+        std::condition_variable mcvDone;
+    };
+
+    std::shared_ptr<Loop> pLoop = std::make_shared<Loop>();
+    pLoop->pf = &f;
+    pLoop->n = n;
+    pLoop->next = 0;
+    pLoop->nDone = 0;
+
+    auto work = [pLoop]()
+    {
+        int nLocal = 0;
+        int i;
+        while((i = pLoop->next++) < pLoop->n)
+        {
+            (*pLoop->pf)(i);
+            nLocal++;
+        }
+
+        if(nLocal>0 && (pLoop->nDone += nLocal) == pLoop->n)
+        {
+            std::unique_lock<std::mutex> lock(pLoop->mMutex);
+            pLoop->mcvDone.notify_all();
+        }
+    };
+
+    const int nHelpers = std::min(n-1, (int)mvThreads.size());
+    {
+        std::unique_lock<std::mutex> lock(mMutexJobs);
+        for(int i=0; i<nHelpers; i++)
+            mlJobs.push_back(work);
+    }
+    if(nHelpers==1)
+        mcvJobs.notify_one();
+    else
+        mcvJobs.notify_all();
+
+    work();
+
+    std::unique_lock<std::mutex> lock(pLoop->mMutex);
+    pLoop->mcvDone.wait(lock, [&pLoop]{return pLoop->nDone == pLoop->n;});
+}
+
+} //namespace ORB_SLAM
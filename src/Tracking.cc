@@ -48,7 +48,8 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
     mbOnlyTracking(false), mbMapUpdated(false), mbVO(false), mpORBVocabulary(pVoc), mpKeyFrameDB(pKFDB),
     mbReadyToInitializate(false), mpSystem(pSys), mpViewer(NULL), bStepByStep(false),
     mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpAtlas(pAtlas), mnLastRelocFrameId(0), time_recently_lost(5.0),
-    mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL))
+    mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL)),
+    mnExtractorThreads(1), mpLocalMapPool(NULL), mpUndistortionLUT(NULL), mpEpochManager(NULL), mnEpochId(-1), mnKeyFrameVoteStamp(0)
 {
     // Load camera parameters from settings file
     if(settings){
@@ -123,6 +124,8 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
     vdRectStereo_ms.clear();
     vdResizeImage_ms.clear();
     vdORBExtract_ms.clear();
+    vdORBExtractLeft_ms.clear();
+    vdORBExtractRight_ms.clear();
     vdStereoMatch_ms.clear();
     vdIMUInteg_ms.clear();
     vdPosePred_ms.clear();
@@ -303,6 +306,19 @@ void Tracking::PrintTimeStats()
     std::cout << "ORB Extraction: " << average << "$\\pm$" << deviation << std::endl;
     f << "ORB Extraction: " << average << "$\\pm$" << deviation << std::endl;
 
+    if(!vdORBExtractLeft_ms.empty())
+    {
+        average = calcAverage(vdORBExtractLeft_ms);
+        deviation = calcDeviation(vdORBExtractLeft_ms, average);
+        std::cout << "ORB Extraction (left job): " << average << "$\\pm$" << deviation << std::endl;
+        f << "ORB Extraction (left job): " << average << "$\\pm$" << deviation << std::endl;
+
+        average = calcAverage(vdORBExtractRight_ms);
+        deviation = calcDeviation(vdORBExtractRight_ms, average);
+        std::cout << "ORB Extraction (right job): " << average << "$\\pm$" << deviation << std::endl;
+        f << "ORB Extraction (right job): " << average << "$\\pm$" << deviation << std::endl;
+    }
+
     if(!vdStereoMatch_ms.empty())
     {
         average = calcAverage(vdStereoMatch_ms);
@@ -532,6 +548,30 @@ Tracking::~Tracking()
 {
     //f_track_stats.close();
 
+    if(Frame::mpUndistortionLUT == mpUndistortionLUT)
+        Frame::mpUndistortionLUT = NULL;
+    delete mpUndistortionLUT;
+}
+
+void Tracking::BuildUndistortionLUT(const cv::Size &imSize, const int nSubdivisions)
+{
+    if(Frame::mpUndistortionLUT == mpUndistortionLUT)
+        Frame::mpUndistortionLUT = NULL;
+    delete mpUndistortionLUT;
+    mpUndistortionLUT = NULL;
+
+    if(nSubdivisions < 1 || mpCamera->GetType() != GeometricCamera::CAM_PINHOLE || mDistCoef.at<float>(0) == 0.0)
+        return;
+
+    if(imSize.width <= 0 || imSize.height <= 0)
+    {
+        std::cerr << "*Camera.width and Camera.height are needed for the undistortion LUT, keypoints will be undistorted with OpenCV*" << std::endl;
+        return;
+    }
+
+    mLUTImSize = imSize;
+    mpUndistortionLUT = new UndistortionLUT(mK,mDistCoef,imSize,nSubdivisions);
+    Frame::mpUndistortionLUT = mpUndistortionLUT;
 }
 
 void Tracking::newParameterLoader(Settings *settings) {
@@ -560,6 +600,8 @@ void Tracking::newParameterLoader(Settings *settings) {
     mK_(0,2) = mpCamera->getParameter(2);
     mK_(1,2) = mpCamera->getParameter(3);
 
+    BuildUndistortionLUT(settings->newImSize(),settings->undistortionLUT());
+
     if((mSensor==System::STEREO || mSensor==System::IMU_STEREO || mSensor==System::IMU_RGBD) &&
         settings->cameraType() == Settings::KannalaBrandt){
         mpCamera2 = settings->camera2();
@@ -593,14 +635,17 @@ void Tracking::newParameterLoader(Settings *settings) {
     int fIniThFAST = settings->initThFAST();
     int fMinThFAST = settings->minThFAST();
     float fScaleFactor = settings->scaleFactor();
+    int nDistribution = settings->distributionMethod();
 
-    mpORBextractorLeft = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+    mpORBextractorLeft = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST,nDistribution);
 
     if(mSensor==System::STEREO || mSensor==System::IMU_STEREO)
-        mpORBextractorRight = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+        mpORBextractorRight = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST,nDistribution);
 
     if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
-        mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+        mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST,nDistribution);
+
+    mnExtractorThreads = settings->nExtractorThreads();
 
     //IMU parameters
     Sophus::SE3f Tbc = settings->Tbc();
@@ -780,6 +825,27 @@ bool Tracking::ParseCamParamFile(cv::FileStorage &fSettings)
         mK_(1,1) = fy;
         mK_(0,2) = cx;
         mK_(1,2) = cy;
+
+        int nLUTSubdivisions = 0;
+        node = fSettings["Camera.undistortionLUT"];
+        if(!node.empty() && node.isInt() && node.operator int() > 0)
+        {
+            nLUTSubdivisions = node.operator int();
+        }
+
+        if(nLUTSubdivisions > 0)
+        {
+            cv::Size imSize;
+            node = fSettings["Camera.width"];
+            if(!node.empty() && node.isInt())
+                imSize.width = node.operator int() * mImageScale;
+            node = fSettings["Camera.height"];
+            if(!node.empty() && node.isInt())
+                imSize.height = node.operator int() * mImageScale;
+
+            std::cout << "- Undistortion LUT subdivisions: " << nLUTSubdivisions << std::endl;
+            BuildUndistortionLUT(imSize,nLUTSubdivisions);
+        }
     }
     else if(sCameraName == "KannalaBrandt8")
     {
@@ -1277,18 +1343,40 @@ bool Tracking::ParseORBParamFile(cv::FileStorage &fSettings)
         b_miss_params = true;
     }
 
+    int nExtractorThreads = 1;
+    node = fSettings["ORBextractor.nThreads"];
+    if(!node.empty() && node.isInt() && node.operator int() > 1)
+    {
+        nExtractorThreads = node.operator int();
+    }
+
+    int nDistribution = ORBextractor::OCTTREE_DISTRIBUTION;
+    node = fSettings["ORBextractor.DistributionMethod"];
+    if(!node.empty() && node.isString())
+    {
+        if(node.string() == "Grid")
+            nDistribution = ORBextractor::GRID_DISTRIBUTION;
+        else if(node.string() != "OctTree")
+        {
+            std::cerr << "*ORBextractor.DistributionMethod must be OctTree or Grid*" << std::endl;
+            b_miss_params = true;
+        }
+    }
+
     if(b_miss_params)
     {
         return false;
     }
 
-    mpORBextractorLeft = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+    mpORBextractorLeft = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST,nDistribution);
 
     if(mSensor==System::STEREO || mSensor==System::IMU_STEREO)
-        mpORBextractorRight = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+        mpORBextractorRight = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST,nDistribution);
 
     if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
-        mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+        mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST,nDistribution);
+
+    mnExtractorThreads = nExtractorThreads;
 
     cout << endl << "ORB Extractor Parameters: " << endl;
     cout << "- Number of Features: " << nFeatures << endl;
@@ -1296,10 +1384,66 @@ bool Tracking::ParseORBParamFile(cv::FileStorage &fSettings)
     cout << "- Scale Factor: " << fScaleFactor << endl;
     cout << "- Initial Fast Threshold: " << fIniThFAST << endl;
     cout << "- Minimum Fast Threshold: " << fMinThFAST << endl;
+    cout << "- Extraction Threads: " << nExtractorThreads << endl;
+    cout << "- Keypoint Distribution: " << (nDistribution == ORBextractor::GRID_DISTRIBUTION ? "Grid" : "OctTree") << endl;
 
     return true;
 }
 
+int Tracking::GetExtractorThreads()
+{
+    return mnExtractorThreads;
+}
+
+void Tracking::SetExtractorPool(ThreadPool* pPool)
+{
+    Frame::mpExtractorPool = pPool;
+
+    // Pyramid levels and local map points are only split among the workers if more than one thread was requested
+    ThreadPool* pLevelPool = mnExtractorThreads>1 ? pPool : NULL;
+    mpLocalMapPool = pLevelPool;
+
+    mpORBextractorLeft->SetThreadPool(pLevelPool);
+    if(mSensor==System::STEREO || mSensor==System::IMU_STEREO)
+        mpORBextractorRight->SetThreadPool(pLevelPool);
+    if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
+        mpIniORBextractor->SetThreadPool(pLevelPool);
+}
+
+void Tracking::SetEpochManager(EpochManager* pEpochManager)
+{
+    mpEpochManager = pEpochManager;
+    if(mpEpochManager)
+        mnEpochId = mpEpochManager->Register();
+}
+
+void Tracking::PurgeBadMapPoints()
+{
+    for(size_t i=0; i<mLastFrame.mvpMapPoints.size(); i++)
+    {
+        MapPoint* pMP = mLastFrame.mvpMapPoints[i];
+        if(pMP && pMP->isBad())
+        {
+            MapPoint* pRep = pMP->GetReplaced();
+            mLastFrame.mvpMapPoints[i] = (pRep && !pRep->isBad()) ? pRep : static_cast<MapPoint*>(NULL);
+        }
+    }
+
+    mvpLocalMapPoints.erase(remove_if(mvpLocalMapPoints.begin(),mvpLocalMapPoints.end(),
+                                      [](MapPoint* pMP){return pMP->isBad();}),
+                            mvpLocalMapPoints.end());
+    // Rebuilt with the local map before the next frustum check
+    mvpLocalPointsInView.clear();
+
+    // The reference and last keyframes are still used while they are bad, until a new one is set
+    if(mpReferenceKF && mpReferenceKF->isBad())
+        return;
+    if(mpLastKeyFrame && mpLastKeyFrame->isBad())
+        return;
+
+    mpEpochManager->Quiescent(mnEpochId);
+}
+
 bool Tracking::ParseIMUParamFile(cv::FileStorage &fSettings)
 {
     bool b_miss_params = false;
@@ -1508,6 +1652,8 @@ Sophus::SE3f Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat
 
 #ifdef REGISTER_TIMES
     vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
+    vdORBExtractLeft_ms.push_back(mCurrentFrame.mTimeORB_ExtLeft);
+    vdORBExtractRight_ms.push_back(mCurrentFrame.mTimeORB_ExtRight);
     vdStereoMatch_ms.push_back(mCurrentFrame.mTimeStereoMatch);
 #endif
 
@@ -1852,6 +1998,8 @@ void Tracking::ResetFrameIMU()
 
 void Tracking::Track()
 {
+    if(mpEpochManager)
+        PurgeBadMapPoints();
 
     if (bStepByStep)
     {
@@ -3453,23 +3601,13 @@ void Tracking::SearchLocalPoints()
         }
     }
 
-    int nToMatch=0;
+    // Project points in frame and check its visibility (this fills MapPoint variables for matching)
+    int nToMatch = mCurrentFrame.isInFrustum(mLocalPointsSnapshot,0.5,mvpLocalPointsInView);
 
-    // Project points in frame and check its visibility
-    for(vector<MapPoint*>::iterator vit=mvpLocalMapPoints.begin(), vend=mvpLocalMapPoints.end(); vit!=vend; vit++)
+    for(vector<MapPoint*>::iterator vit=mvpLocalPointsInView.begin(), vend=mvpLocalPointsInView.end(); vit!=vend; vit++)
     {
         MapPoint* pMP = *vit;
-
-        if(pMP->mnLastFrameSeen == mCurrentFrame.mnId)
-            continue;
-        if(pMP->isBad())
-            continue;
-        // Project (this fills MapPoint variables for matching)
-        if(mCurrentFrame.isInFrustum(pMP,0.5))
-        {
-            pMP->IncreaseVisible();
-            nToMatch++;
-        }
+        pMP->IncreaseVisible();
         if(pMP->mbTrackInView)
         {
             mCurrentFrame.mmProjectPoints[pMP->mnId] = cv::Point2f(pMP->mTrackProjX, pMP->mTrackProjY);
@@ -3501,7 +3639,7 @@ void Tracking::SearchLocalPoints()
         if(mState==LOST || mState==RECENTLY_LOST) // Lost for less than 1 second
             th=15; // 15
 
-        int matches = matcher.SearchByProjection(mCurrentFrame, mvpLocalMapPoints, th, mpLocalMapper->mbFarPoints, mpLocalMapper->mThFarPoints);
+        int matches = matcher.SearchByProjection(mCurrentFrame, mvpLocalPointsInView, th, mpLocalMapper->mbFarPoints, mpLocalMapper->mThFarPoints, mpLocalMapPool);
     }
 }
 
@@ -3542,13 +3680,53 @@ void Tracking::UpdateLocalPoints()
             }
         }
     }
+
+    // In localization mode and after a relocalization the covisible keyframes may not cover the view,
+    // add the points of the map in the frustum of the current pose up to twice the scene depth
+    if((mbOnlyTracking || mCurrentFrame.mnId<mnLastRelocFrameId+2) && mpReferenceKF)
+    {
+        const float maxDepth = 2.f*mpReferenceKF->ComputeSceneMedianDepth(2);
+        if(maxDepth>0.f)
+        {
+            const vector<MapPoint*> vpMPs = mpAtlas->GetCurrentMap()->GetMapPointsInFrustum(mCurrentFrame.GetPose(),mCurrentFrame.mpCamera,
+                                                                                             Frame::mnMinX,Frame::mnMaxX,Frame::mnMinY,Frame::mnMaxY,maxDepth);
+            for(MapPoint* pMP : vpMPs)
+            {
+                if(pMP->mnTrackReferenceForFrame==mCurrentFrame.mnId || pMP->isBad())
+                    continue;
+                mvpLocalMapPoints.push_back(pMP);
+                pMP->mnTrackReferenceForFrame=mCurrentFrame.mnId;
+            }
+        }
+    }
+
+    mLocalPointsSnapshot.Assign(mvpLocalMapPoints);
 }
 
 
 void Tracking::UpdateLocalKeyFrames()
 {
     // Each map point vote for the keyframes in which it has been observed
-    map<KeyFrame*,int> keyframeCounter;
+    mnKeyFrameVoteStamp++;
+    mvpVotedKeyFrames.clear();
+    auto vote = [this](KeyFrame* pKF, int, int)
+    {
+        const size_t id = pKF->mnId;
+        if(id>=mvKeyFrameVotes.size())
+        {
+            const size_t n = max(id+1,2*mvKeyFrameVotes.size());
+            mvKeyFrameVotes.resize(n,0);
+            mvKeyFrameVoteStamps.resize(n,0);
+        }
+        if(mvKeyFrameVoteStamps[id]!=mnKeyFrameVoteStamp)
+        {
+            mvKeyFrameVoteStamps[id] = mnKeyFrameVoteStamp;
+            mvKeyFrameVotes[id] = 0;
+            mvpVotedKeyFrames.push_back(pKF);
+        }
+        mvKeyFrameVotes[id]++;
+    };
+
     if(!mpAtlas->isImuInitialized() || (mCurrentFrame.mnId<mnLastRelocFrameId+2))
     {
         for(int i=0; i<mCurrentFrame.N; i++)
@@ -3558,9 +3736,7 @@ void Tracking::UpdateLocalKeyFrames()
             {
                 if(!pMP->isBad())
                 {
-                    const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
-                    for(map<KeyFrame*,tuple<int,int>>::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
-                        keyframeCounter[it->first]++;
+                    pMP->ForEachObservation(vote);
                 }
                 else
                 {
@@ -3581,9 +3757,7 @@ void Tracking::UpdateLocalKeyFrames()
                     continue;
                 if(!pMP->isBad())
                 {
-                    const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
-                    for(map<KeyFrame*,tuple<int,int>>::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
-                        keyframeCounter[it->first]++;
+                    pMP->ForEachObservation(vote);
                 }
                 else
                 {
@@ -3599,19 +3773,20 @@ void Tracking::UpdateLocalKeyFrames()
     KeyFrame* pKFmax= static_cast<KeyFrame*>(NULL);
 
     mvpLocalKeyFrames.clear();
-    mvpLocalKeyFrames.reserve(3*keyframeCounter.size());
+    mvpLocalKeyFrames.reserve(3*mvpVotedKeyFrames.size());
 
     // All keyframes that observe a map point are included in the local map. Also check which keyframe shares most points
-    for(map<KeyFrame*,int>::const_iterator it=keyframeCounter.begin(), itEnd=keyframeCounter.end(); it!=itEnd; it++)
+    for(size_t i=0; i<mvpVotedKeyFrames.size(); i++)
     {
-        KeyFrame* pKF = it->first;
+        KeyFrame* pKF = mvpVotedKeyFrames[i];
 
         if(pKF->isBad())
             continue;
 
-        if(it->second>max)
+        const int nVotes = mvKeyFrameVotes[pKF->mnId];
+        if(nVotes>max)
         {
-            max=it->second;
+            max=nVotes;
             pKFmax=pKF;
         }
 
@@ -3619,21 +3794,22 @@ void Tracking::UpdateLocalKeyFrames()
         pKF->mnTrackReferenceForFrame = mCurrentFrame.mnId;
     }
 
-    // Include also some not-already-included keyframes that are neighbors to already-included keyframes
-    for(vector<KeyFrame*>::const_iterator itKF=mvpLocalKeyFrames.begin(), itEndKF=mvpLocalKeyFrames.end(); itKF!=itEndKF; itKF++)
+    // Include also some not-already-included keyframes that are neighbors to already-included keyframes.
+    // Only the voted keyframes are expanded, the vector grows while it is walked
+    const size_t nVoted = mvpLocalKeyFrames.size();
+    for(size_t iKF=0; iKF<nVoted; iKF++)
     {
         // Limit the number of keyframes
         if(mvpLocalKeyFrames.size()>80) // 80
             break;
 
-        KeyFrame* pKF = *itKF;
+        KeyFrame* pKF = mvpLocalKeyFrames[iKF];
 
-        const vector<KeyFrame*> vNeighs = pKF->GetBestCovisibilityKeyFrames(10);
+        pKF->GetBestCovisibilityKeyFrames(10,mvpNeighborKeyFrames);
 
-
-        for(vector<KeyFrame*>::const_iterator itNeighKF=vNeighs.begin(), itEndNeighKF=vNeighs.end(); itNeighKF!=itEndNeighKF; itNeighKF++)
+        for(size_t i=0; i<mvpNeighborKeyFrames.size(); i++)
         {
-            KeyFrame* pNeighKF = *itNeighKF;
+            KeyFrame* pNeighKF = mvpNeighborKeyFrames[i];
             if(!pNeighKF->isBad())
             {
                 if(pNeighKF->mnTrackReferenceForFrame!=mCurrentFrame.mnId)
@@ -3645,10 +3821,10 @@ void Tracking::UpdateLocalKeyFrames()
             }
         }
 
-        const set<KeyFrame*> spChilds = pKF->GetChilds();
-        for(set<KeyFrame*>::const_iterator sit=spChilds.begin(), send=spChilds.end(); sit!=send; sit++)
+        pKF->GetChilds(mvpNeighborKeyFrames);
+        for(size_t i=0; i<mvpNeighborKeyFrames.size(); i++)
         {
-            KeyFrame* pChildKF = *sit;
+            KeyFrame* pChildKF = mvpNeighborKeyFrames[i];
             if(!pChildKF->isBad())
             {
                 if(pChildKF->mnTrackReferenceForFrame!=mCurrentFrame.mnId)
@@ -4176,6 +4352,9 @@ void Tracking::ChangeCalibration(const string &strSettingPath)
     }
     DistCoef.copyTo(mDistCoef);
 
+    if(mpUndistortionLUT)
+        BuildUndistortionLUT(mLUTImSize,mpUndistortionLUT->GetSubdivisions());
+
     mbf = fSettings["Camera.bf"];
 
     Frame::mbInitialComputations = true;
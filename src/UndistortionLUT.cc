@@ -0,0 +1,196 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "UndistortionLUT.h"
+
+#include <algorithm>
+
+#include <opencv2/calib3d/calib3d.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UNDISTORTIONLUT_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace ORB_SLAM3
+{
+
+UndistortionLUT::UndistortionLUT(const cv::Mat &K, const cv::Mat &distCoef, const cv::Size &imSize, const int nSubdivisions):
+    mK(K.clone()), mDistCoef(distCoef.clone()), mnSubdivisions(std::max(nSubdivisions,1)),
+    mfMaxX(imSize.width-1), mfMaxY(imSize.height-1)
+{
+    // Nodes cover [0,width]x[0,height], so every pixel inside the image has its four neighbors
+    mnStride = imSize.width*mnSubdivisions+1;
+    const int nRows = imSize.height*mnSubdivisions+1;
+    const float invSub = 1.f/mnSubdivisions;
+
+    cv::Mat nodes(nRows*mnStride,1,CV_32FC2);
+    for(int iy=0; iy<nRows; iy++)
+    {
+        cv::Vec2f* pRow = nodes.ptr<cv::Vec2f>(iy*mnStride);
+        for(int ix=0; ix<mnStride; ix++)
+            pRow[ix] = cv::Vec2f(ix*invSub,iy*invSub);
+    }
+
+    cv::undistortPoints(nodes,nodes,mK,mDistCoef,cv::Mat(),mK);
+
+    mvMapX.resize(nodes.rows);
+    mvMapY.resize(nodes.rows);
+    for(int i=0; i<nodes.rows; i++)
+    {
+        const cv::Vec2f &p = nodes.at<cv::Vec2f>(i);
+        mvMapX[i] = p[0];
+        mvMapY[i] = p[1];
+    }
+}
+
+// Bilinear interpolation of the four nodes around a point, with (ax,ay) its offset from the top-left node
+static inline float Bilinear(const float* pMap, const int idx, const int stride, const float ax, const float ay)
+{
+    const float top = pMap[idx] + ax*(pMap[idx+1]-pMap[idx]);
+    const float bottom = pMap[idx+stride] + ax*(pMap[idx+stride+1]-pMap[idx+stride]);
+    return top + ay*(bottom-top);
+}
+
+#ifdef UNDISTORTIONLUT_X86_DISPATCH
+
+__attribute__((target("avx2")))
+static inline __m256 BilinearAVX2(const float* pMap, const __m256i i00, const __m256i i01, const __m256i i10,
+                                  const __m256i i11, const __m256 ax, const __m256 ay)
+{
+    const __m256 v00 = _mm256_i32gather_ps(pMap,i00,4);
+    const __m256 v01 = _mm256_i32gather_ps(pMap,i01,4);
+    const __m256 v10 = _mm256_i32gather_ps(pMap,i10,4);
+    const __m256 v11 = _mm256_i32gather_ps(pMap,i11,4);
+    const __m256 top = _mm256_add_ps(v00,_mm256_mul_ps(ax,_mm256_sub_ps(v01,v00)));
+    const __m256 bottom = _mm256_add_ps(v10,_mm256_mul_ps(ax,_mm256_sub_ps(v11,v10)));
+    return _mm256_add_ps(top,_mm256_mul_ps(ay,_mm256_sub_ps(bottom,top)));
+}
+
+// Eight points per iteration, with the same arithmetic as the scalar path. Returns the number of points processed.
+__attribute__((target("avx2")))
+static int InterpolateAVX2(const float* pMapX, const float* pMapY, const int stride, const float s,
+                           const float* pX, const float* pY, const int n, float* pXUn, float* pYUn)
+{
+    const __m256 vs = _mm256_set1_ps(s);
+    const __m256i vStride = _mm256_set1_epi32(stride);
+    const __m256i vOne = _mm256_set1_epi32(1);
+
+    int i=0;
+    for(; i+8<=n; i+=8)
+    {
+        const __m256 fx = _mm256_mul_ps(_mm256_loadu_ps(pX+i),vs);
+        const __m256 fy = _mm256_mul_ps(_mm256_loadu_ps(pY+i),vs);
+        const __m256i ix = _mm256_cvttps_epi32(fx);
+        const __m256i iy = _mm256_cvttps_epi32(fy);
+        const __m256 ax = _mm256_sub_ps(fx,_mm256_cvtepi32_ps(ix));
+        const __m256 ay = _mm256_sub_ps(fy,_mm256_cvtepi32_ps(iy));
+
+        const __m256i i00 = _mm256_add_epi32(_mm256_mullo_epi32(iy,vStride),ix);
+        const __m256i i01 = _mm256_add_epi32(i00,vOne);
+        const __m256i i10 = _mm256_add_epi32(i00,vStride);
+        const __m256i i11 = _mm256_add_epi32(i10,vOne);
+
+        _mm256_storeu_ps(pXUn+i,BilinearAVX2(pMapX,i00,i01,i10,i11,ax,ay));
+        _mm256_storeu_ps(pYUn+i,BilinearAVX2(pMapY,i00,i01,i10,i11,ax,ay));
+    }
+    return i;
+}
+
+#endif
+
+void UndistortionLUT::Interpolate(const float* pX, const float* pY, const int n, float* pXUn, float* pYUn) const
+{
+    const float s = mnSubdivisions;
+    int i=0;
+
+#ifdef UNDISTORTIONLUT_X86_DISPATCH
+    static const bool bAVX2 = __builtin_cpu_supports("avx2");
+    if(bAVX2)
+        i = InterpolateAVX2(mvMapX.data(),mvMapY.data(),mnStride,s,pX,pY,n,pXUn,pYUn);
+#endif
+
+    for(; i<n; i++)
+    {
+        const float fx = pX[i]*s;
+        const float fy = pY[i]*s;
+        const int ix = static_cast<int>(fx);
+        const int iy = static_cast<int>(fy);
+        const float ax = fx-ix;
+        const float ay = fy-iy;
+        const int idx = iy*mnStride+ix;
+
+        pXUn[i] = Bilinear(mvMapX.data(),idx,mnStride,ax,ay);
+        pYUn[i] = Bilinear(mvMapY.data(),idx,mnStride,ax,ay);
+    }
+}
+
+void UndistortionLUT::Undistort(const std::vector<cv::KeyPoint> &vKeys, std::vector<cv::KeyPoint> &vKeysUn) const
+{
+    const int N = vKeys.size();
+    vKeysUn = vKeys;
+
+    // Coordinates of the keypoints inside the image, as separate arrays for the batch interpolation
+    std::vector<int> vInside, vOutside;
+    std::vector<float> vX, vY;
+    vInside.reserve(N);
+    vX.reserve(N);
+    vY.reserve(N);
+
+    for(int i=0; i<N; i++)
+    {
+        const cv::Point2f &pt = vKeys[i].pt;
+        if(pt.x>=0 && pt.y>=0 && pt.x<=mfMaxX && pt.y<=mfMaxY)
+        {
+            vInside.push_back(i);
+            vX.push_back(pt.x);
+            vY.push_back(pt.y);
+        }
+        else
+            vOutside.push_back(i);
+    }
+
+    const int nInside = vInside.size();
+    std::vector<float> vXUn(nInside), vYUn(nInside);
+    Interpolate(vX.data(),vY.data(),nInside,vXUn.data(),vYUn.data());
+
+    for(int i=0; i<nInside; i++)
+    {
+        cv::KeyPoint &kp = vKeysUn[vInside[i]];
+        kp.pt.x = vXUn[i];
+        kp.pt.y = vYUn[i];
+    }
+
+    if(vOutside.empty())
+        return;
+
+    cv::Mat mat(vOutside.size(),1,CV_32FC2);
+    for(size_t i=0; i<vOutside.size(); i++)
+        mat.at<cv::Vec2f>(i) = cv::Vec2f(vKeys[vOutside[i]].pt.x,vKeys[vOutside[i]].pt.y);
+
+    cv::undistortPoints(mat,mat,mK,mDistCoef,cv::Mat(),mK);
+
+    for(size_t i=0; i<vOutside.size(); i++)
+    {
+        const cv::Vec2f &p = mat.at<cv::Vec2f>(i);
+        vKeysUn[vOutside[i]].pt = cv::Point2f(p[0],p[1]);
+    }
+}
+
+} //namespace ORB_SLAM
@@ -27,7 +27,8 @@ namespace ORB_SLAM3
 
 Viewer::Viewer(System* pSystem, FrameDrawer *pFrameDrawer, MapDrawer *pMapDrawer, Tracking *pTracking, const string &strSettingPath, Settings* settings):
     both(false), mpSystem(pSystem), mpFrameDrawer(pFrameDrawer),mpMapDrawer(pMapDrawer), mpTracker(pTracking),
-    mbFinishRequested(false), mbFinished(true), mbStopped(true), mbStopRequested(false)
+    mbFinishRequested(false), mbFinished(true), mbStopped(true), mbStopRequested(false),
+    mpEpochManager(NULL), mnEpochId(-1)
 {
     if(settings){
         newParameterLoader(settings);
@@ -368,10 +369,16 @@ void Viewer::Run()
             menuStop = false;
         }
 
+        // The points and keyframes drawn are taken again from the map in the next iteration
+        if(mpEpochManager)
+            mpEpochManager->Quiescent(mnEpochId);
+
         if(Stop())
         {
             while(isStopped())
             {
+                if(mpEpochManager)
+                    mpEpochManager->Quiescent(mnEpochId);
                 usleep(3000);
             }
         }
@@ -380,9 +387,19 @@ void Viewer::Run()
             break;
     }
 
+    if(mpEpochManager)
+        mpEpochManager->Unregister(mnEpochId);
+
     SetFinish();
 }
 
+void Viewer::SetEpochManager(EpochManager* pEpochManager)
+{
+    mpEpochManager = pEpochManager;
+    if(mpEpochManager)
+        mnEpochId = mpEpochManager->Register();
+}
+
 void Viewer::RequestFinish()
 {
     unique_lock<mutex> lock(mMutexFinish);